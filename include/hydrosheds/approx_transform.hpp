@@ -0,0 +1,165 @@
+#pragma once
+
+#include <ogr_spatialref.h>
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace hydrosheds {
+
+/// @brief Approximates a coordinate transformation with bilinear grids.
+///
+/// The input space is split into square cells covering about a tile of the
+/// raster. Their size is estimated around the first point of each call and
+/// rounded to a power of two, so that the grids of the calls nest whatever
+/// the scale of the transformation where their points are. The exact
+/// transformation is evaluated at the corners, the middle
+/// of the edges and the center of a cell the first time a point falls in it.
+/// If the bilinear interpolation of the corners reproduces the other samples
+/// within the maximum error, the points of the cell are interpolated.
+/// Otherwise the cell is split in four, down to kMaxDepth levels, below which
+/// the points are transformed exactly. The cells are kept between the calls.
+///
+/// The object is not thread-safe: each thread owns its own instance, as it
+/// owns its copy of the exact transformation.
+class ApproxTransform {
+ public:
+  /// @brief Maximum number of times a cell is split in four.
+  static constexpr uint32_t kMaxDepth = 6;
+
+  /// @brief Maximum number of cells kept, the grid is rebuilt beyond.
+  static constexpr size_t kMaxCells = size_t(1) << 16U;
+
+  /// @brief Maximum number of points tried to estimate the size of the
+  /// cells.
+  static constexpr size_t kMaxProbes = 16;
+
+  /// @brief Largest coordinate handled, in cells of the first level.
+  static constexpr double kMaxCoordinate = 1e15;
+
+  /// @brief Constructs the approximation of a transformation.
+  ///
+  /// @param[in] transform The exact transformation, which must outlive the
+  /// object.
+  /// @param[in] geotransform The geotransform of the raster, used to express
+  /// the error in pixels.
+  /// @param[in] max_error The maximum error, in pixels.
+  /// @param[in] cell_pixels The approximate size of a cell of the first
+  /// level, in pixels.
+  ApproxTransform(OGRCoordinateTransformation *transform,
+                  const std::array<double, 6> &geotransform, double max_error,
+                  size_t cell_pixels);
+
+  /// @brief Transforms points, like OGRCoordinateTransformation::Transform.
+  ///
+  /// @param[in] size The number of points.
+  /// @param[in,out] x The x-coordinates of the points.
+  /// @param[in,out] y The y-coordinates of the points.
+  /// @param[out] success Set to 1 for the points transformed, 0 otherwise.
+  auto transform(size_t size, double *x, double *y, int *success) -> void;
+
+ private:
+  /// @brief Identifies a cell of the grid.
+  struct CellKey {
+    /// @brief Size of the cell in the input space, as a power of two.
+    int32_t exponent;
+    /// @brief Index of the cell in the x-direction.
+    int64_t x;
+    /// @brief Index of the cell in the y-direction.
+    int64_t y;
+
+    auto operator==(const CellKey &other) const noexcept -> bool {
+      return exponent == other.exponent && x == other.x && y == other.y;
+    }
+  };
+
+  /// @brief Hashes the key of a cell.
+  struct CellHash {
+    auto operator()(const CellKey &key) const noexcept -> size_t {
+      auto hash = std::hash<int64_t>()(key.x);
+      hash ^= std::hash<int64_t>()(key.y) + 0x9e3779b97f4a7c15ULL +
+              (hash << 6U) + (hash >> 2U);
+      return hash ^ static_cast<size_t>(static_cast<uint32_t>(key.exponent));
+    }
+  };
+
+  /// @brief Bilinear approximation of the transformation over a cell.
+  struct Cell {
+    /// @brief Coefficients a, b, c, d of a + b u + c v + d u v for x, then
+    /// for y, where u and v are the position of the point in the cell.
+    std::array<double, 8> coefficients{};
+    /// @brief True if the cell is split into finer cells.
+    bool split{};
+    /// @brief True if the points of the cell are transformed exactly.
+    bool exact{};
+  };
+
+  /// @brief Exact transformation.
+  OGRCoordinateTransformation *transform_;
+  /// @brief Number of pixels per unit of the output space, along x.
+  double scale_x_;
+  /// @brief Number of pixels per unit of the output space, along y.
+  double scale_y_;
+  /// @brief Maximum error, in pixels.
+  double max_error_;
+  /// @brief Approximate size of a cell of the first level, in pixels.
+  size_t cell_pixels_;
+  /// @brief Size of the cells of the first level in the input space, as a
+  /// power of two, estimated at the first point of the current call.
+  int32_t exponent_{0};
+  /// @brief True once the size of the cells has been estimated.
+  bool estimated_{false};
+  /// @brief Cells built so far.
+  std::unordered_map<CellKey, Cell, CellHash> cells_{};
+  /// @brief Cell of each point of the current call, null if the point is
+  /// transformed exactly.
+  std::vector<const Cell *> owners_{};
+  /// @brief Position of the points in their cell along x.
+  std::vector<double> u_{};
+  /// @brief Position of the points in their cell along y.
+  std::vector<double> v_{};
+  /// @brief Coefficients of the cell of each point, gathered by coefficient.
+  std::array<std::vector<double>, 8> gathered_{};
+  /// @brief Index of the points transformed exactly.
+  std::vector<size_t> exact_{};
+  /// @brief Coordinates of the points transformed exactly.
+  std::vector<double> exact_x_{};
+  /// @brief Coordinates of the points transformed exactly.
+  std::vector<double> exact_y_{};
+  /// @brief Status of the points transformed exactly.
+  std::vector<int> exact_success_{};
+
+  /// @brief Estimates the size of the cells of the first level around a
+  /// point, rounded to a power of two.
+  /// @param[in] x The x-coordinate of the point.
+  /// @param[in] y The y-coordinate of the point.
+  /// @return False if the transformation fails around the point.
+  auto estimate_cell_size(double x, double y) -> bool;
+
+  /// @brief Gets the finest cell containing a point, building it if needed.
+  /// @param[in] x The x-coordinate of the point.
+  /// @param[in] y The y-coordinate of the point.
+  /// @param[out] u The position of the point in the cell along x.
+  /// @param[out] v The position of the point in the cell along y.
+  /// @return The cell.
+  auto find(double x, double y, double &u, double &v) -> const Cell &;
+
+  /// @brief Builds a cell, checking the error of the interpolation.
+  /// @param[in] key The key of the cell.
+  /// @return The cell.
+  auto build(const CellKey &key) const -> Cell;
+
+  /// @brief Gets the size of the cells in the input space.
+  /// @param[in] exponent The size of the cells, as a power of two.
+  /// @return The size of the cells.
+  static inline auto cell_size(int32_t exponent) noexcept -> double {
+    return std::ldexp(1.0, exponent);
+  }
+};
+
+}  // namespace hydrosheds
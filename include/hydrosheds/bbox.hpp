@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <cmath>
 #include <cstddef>
 
 namespace hydrosheds {
@@ -26,6 +27,16 @@ class BBox {
         min_y_(geotransform[3] + geotransform[5] * y_size),
         max_y_(geotransform[3]) {}
 
+  /// @brief Constructs a BBox object from its corners.
+  ///
+  /// @param[in] min_x The minimum x-coordinate.
+  /// @param[in] min_y The minimum y-coordinate.
+  /// @param[in] max_x The maximum x-coordinate.
+  /// @param[in] max_y The maximum y-coordinate.
+  constexpr BBox(double min_x, double min_y, double max_x,
+                 double max_y) noexcept
+      : min_x_(min_x), max_x_(max_x), min_y_(min_y), max_y_(max_y) {}
+
   /// @brief Checks if a given point (longitude, latitude) is within the
   /// bounding box.
   ///
@@ -37,6 +48,40 @@ class BBox {
     return lon >= min_x_ && lon <= max_x_ && lat >= min_y_ && lat <= max_y_;
   }
 
+  /// @brief Checks if another bounding box lies entirely within this one.
+  ///
+  /// @param[in] other The other bounding box.
+  /// @return true if the other box is within the bounding box, false
+  /// otherwise or if one of its coordinates is NaN.
+  constexpr bool contains(const BBox &other) const noexcept {
+    return other.min_x_ >= min_x_ && other.max_x_ <= max_x_ &&
+           other.min_y_ >= min_y_ && other.max_y_ <= max_y_;
+  }
+
+  /// @brief Checks if another bounding box shares at least a point with
+  /// this one.
+  ///
+  /// @param[in] other The other bounding box.
+  /// @return true if the boxes intersect, false otherwise or if one of the
+  /// coordinates of the other box is NaN.
+  constexpr bool intersects(const BBox &other) const noexcept {
+    return other.min_x_ <= max_x_ && other.max_x_ >= min_x_ &&
+           other.min_y_ <= max_y_ && other.max_y_ >= min_y_;
+  }
+
+  /// @brief Wraps a longitude into the 360 degrees starting at the western
+  /// edge of the bounding box.
+  ///
+  /// The longitudes given in [0, 360) are brought back to the range of a box
+  /// in [-180, 180), and the other way round. A box crossing the antimeridian,
+  /// for example [170, 190], contains the wrapped longitudes on both sides.
+  ///
+  /// @param[in] lon The longitude, in degrees.
+  /// @return The longitude in [min_x, min_x + 360).
+  inline auto wrap_longitude(double lon) const noexcept -> double {
+    return lon - 360.0 * std::floor((lon - min_x_) / 360.0);
+  }
+
   /// @brief Gets the minimum x-coordinate of the bounding box.
   ///
   /// @return The minimum x-coordinate of the bounding box.
@@ -4,21 +4,50 @@
 #include <ogr_spatialref.h>
 
 #include <Eigen/Core>
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "hydrosheds/approx_transform.hpp"
 #include "hydrosheds/bbox.hpp"
+#include "hydrosheds/disk_cache.hpp"
+#include "hydrosheds/mask_pyramid.hpp"
+#include "hydrosheds/numa.hpp"
+#include "hydrosheds/packed_mask.hpp"
+#include "hydrosheds/prefetcher.hpp"
+#include "hydrosheds/prepared_points.hpp"
+#include "hydrosheds/projection.hpp"
+#include "hydrosheds/quadtree.hpp"
+#include "hydrosheds/tile_arena.hpp"
+#include "hydrosheds/tiff_reader.hpp"
 #include "hydrosheds/tile_cache.hpp"
+#include "hydrosheds/warm_progress.hpp"
 
 namespace hydrosheds {
 
 /// @brief Alias for a vector of boolean values.
 using VectorBool = Eigen::Array<bool, Eigen::Dynamic, 1>;
 
+/// @brief Alias for a vector of 8-bit unsigned integer values.
+using VectorUInt8 = Eigen::Array<uint8_t, Eigen::Dynamic, 1>;
+
+/// @brief Alias for a vector of 16-bit integer values.
+using VectorInt16 = Eigen::Array<int16_t, Eigen::Dynamic, 1>;
+
+/// @brief Alias for a vector of 64-bit integer values.
+using VectorInt64 = Eigen::Array<int64_t, Eigen::Dynamic, 1>;
+
 /// @brief Alias for a vector of double values.
 using VectorFloat64 = Eigen::Array<double, Eigen::Dynamic, 1>;
 
@@ -29,11 +58,76 @@ using ConstRefVectorFloat64 = const Eigen::Ref<const VectorFloat64> &;
 using GDALDatasetSmartPtr =
     std::unique_ptr<GDALDataset, void (*)(GDALDataset *)>;
 
-/// @brief Holds a pointer to an OGRCoordinateTransformation object and a custom
-/// deleter.
-using OGRCoordinateTransformationSmartPtr =
-    std::unique_ptr<OGRCoordinateTransformation,
-                    void (*)(OGRCoordinateTransformation *)>;
+/// @brief Class of a point returned by Dataset::classify.
+enum class PointClass : uint8_t {
+  /// @brief The point is land.
+  kLand = 0,
+  /// @brief The point is water.
+  kWater = 1,
+  /// @brief The pixel holding the point is nodata.
+  kNoData = 2,
+  /// @brief No dataset covers the point.
+  kOutside = 3,
+};
+
+/// @brief Policy applied to the GDAL block cache when a tile is read through
+/// GDAL.
+enum class BlockCacheMode : uint8_t {
+  /// @brief Drop the blocks if they are entirely copied to the tile, i.e. if
+  /// the size of the blocks divides the size of the tiles.
+  kAuto = 0,
+  /// @brief Keep the blocks in the GDAL block cache.
+  kKeep = 1,
+  /// @brief Drop the blocks from the GDAL block cache once copied to the tile.
+  kDrop = 2,
+};
+
+/// @brief Form of the result of a water query.
+enum class OutputMode : uint8_t {
+  /// @brief One boolean per point.
+  kBool = 0,
+  /// @brief One bit per point, packed as numpy.packbits does: the first
+  /// point is the most significant bit of the first byte.
+  kPacked = 1,
+  /// @brief The sorted index of the water points.
+  kIndices = 2,
+  /// @brief The number of water points.
+  kCount = 3,
+};
+
+/// @brief Describes how the tiles are loaded and cached.
+struct CacheStats {
+  /// @brief How each dataset is read: "direct" for the tiles decoded without
+  /// GDAL, "keep" or "drop" for the tiles read through GDAL according to the
+  /// policy applied to its block cache, "quadtree" for the datasets held in
+  /// memory.
+  std::vector<std::string> modes;
+  /// @brief Number of tiles decoded without GDAL.
+  uint64_t direct_reads;
+  /// @brief Number of tiles read through GDAL.
+  uint64_t gdal_reads;
+  /// @brief Number of blocks dropped from the GDAL block cache.
+  uint64_t dropped_blocks;
+  /// @brief Number of tiles found in the shared caches.
+  uint64_t shared_hits;
+  /// @brief Number of batches of tiles read together without GDAL.
+  uint64_t batches;
+  /// @brief Number of GDAL reads covering several adjacent tiles.
+  uint64_t coalesced_reads;
+  /// @brief Number of tiles mapped from the disk cache.
+  uint64_t disk_hits;
+  /// @brief Number of tiles written to the disk cache.
+  uint64_t disk_writes;
+  /// @brief Number of tiles queued for the read-ahead.
+  uint64_t prefetch_issued;
+  /// @brief Number of tiles loaded by the read-ahead then used by a query.
+  uint64_t prefetch_hits;
+  /// @brief Fraction of the tiles queued for the read-ahead that were used.
+  double prefetch_hit_ratio;
+  /// @brief Memory used by the GDAL block cache, in bytes, shared by all the
+  /// GDAL datasets of the process.
+  int64_t gdal_cache_used;
+};
 
 /// @brief Represents a HydroSHEDS dataset and provides a method to check if a
 /// given point is water.
@@ -42,25 +136,106 @@ class Dataset {
   /// @brief Constructs a Dataset object with a list of paths to HydroSHEDS
   /// datasets, a tile size, and a maximum cache size.
   ///
-  /// @param[in] paths A list of paths to HydroSHEDS datasets.
+  /// @param[in] paths A list of paths to HydroSHEDS datasets. Paths with the
+  /// extension ".lqt" are loaded as linear quadtrees (see build_quadtree) and
+  /// kept in memory, the other paths are read with GDAL.
   /// @param[in] espg_code The EPSG code used to transform the input coordinates
   /// to the dataset's projection. Defaults to 4326.
   /// @param[in] tile_size The size of the tiles used to cache the datasets.
   /// Defaults to 256.
-  /// @param[in] max_cache_size The maximum number of tiles that the cache can
-  /// hold. Defaults to 4096.
+  /// @param[in] max_cache_size The maximum number of tiles held in memory by
+  /// the caches shared by the threads and kept between the calls, for all the
+  /// datasets. The budget is split evenly between the datasets read through
+  /// the caches and, with the NUMA placement, between the nodes, each having
+  /// its own caches. Defaults to 4096, 256 MiB with the default tile size.
+  /// @param[in] pyramid If set, a mask pyramid is used to answer the queries
+  /// located in uniform regions without loading the tiles. The value is the
+  /// directory where the pyramids are loaded from, or saved to once built. An
+  /// empty string builds the pyramids in memory only. A saved pyramid is
+  /// rebuilt when the path, size, modification time or geotransform of the
+  /// files of its dataset change. Defaults to no pyramid.
+  /// @param[in] numa If true, the worker threads are pinned to the NUMA nodes
+  /// of the machine, each node has its own tile cache, and the points are
+  /// dispatched to the node caching their tile. Defaults to false.
+  /// @param[in] block_cache The policy applied to the GDAL block cache for the
+  /// tiles read through GDAL, to avoid holding the pixels both in the GDAL
+  /// block cache and in the tile cache. Defaults to kAuto.
+  /// @param[in] readahead If true, the neighbours of a missing tile are loaded
+  /// in the background, the ones in the direction of travel first. The number
+  /// of neighbours loaded is throttled by the fraction of the tiles loaded
+  /// ahead that the queries use. Defaults to false.
+  /// @param[in] preload If true, the datasets read with GDAL are decoded in
+  /// parallel at construction into bit-packed masks held in memory, and the
+  /// queries test a bit instead of going through the tile caches. Needs one
+  /// bit per pixel, two if the dataset has a nodata value. Defaults to false.
+  /// @param[in] disk_cache If set, the directory where the decoded tiles are
+  /// written the first time they are read, and mapped in memory from by the
+  /// following runs. The tiles of a dataset are discarded when its
+  /// geotransform, or the path, size or modification time of one of its
+  /// files, for example the sources of a VRT, change. Defaults to no disk
+  /// cache.
+  /// @param[in] max_transform_error If positive, the input coordinates are
+  /// transformed to the projection of each dataset with bilinear grids
+  /// approximating the exact transformation within this error, in pixels.
+  /// Defaults to 0, the exact transformation.
   Dataset(const std::vector<std::string> &paths, int espg_code = 4326,
-          size_t tile_size = 256, size_t max_cache_size = 4096)
+          size_t tile_size = 256, size_t max_cache_size = 4096,
+          const std::optional<std::string> &pyramid = std::nullopt,
+          bool numa = false,
+          BlockCacheMode block_cache = BlockCacheMode::kAuto,
+          bool readahead = false, bool preload = false,
+          const std::optional<std::string> &disk_cache = std::nullopt,
+          double max_transform_error = 0)
       : tile_size_(tile_size),
         max_cache_size_(max_cache_size),
-        espg_code_(espg_code) {
+        espg_code_(espg_code),
+        block_cache_(block_cache),
+        max_transform_error_(max_transform_error),
+        topology_(numa ? NumaTopology::detect() : NumaTopology()) {
     GDALAllRegister();
 
+    for (size_t ix = 0; ix < topology_.size(); ++ix) {
+      arenas_.emplace_back(
+          std::make_unique<TileArena>(tile_size_ * tile_size_));
+    }
+    idle_contexts_.resize(topology_.size());
     for (const auto &path : paths) {
       base_datasets_.emplace_back(init_dataset_info(path));
+      auto &dataset_info = *base_datasets_.back();
+      if (pyramid && dataset_info.dataset) {
+        init_pyramid(path, *pyramid, dataset_info);
+      }
+      if (preload && dataset_info.dataset) {
+        preload_masks(dataset_info);
+      }
+      if (disk_cache && dataset_info.dataset && !dataset_info.preloaded) {
+        dataset_info.disk_cache =
+            DiskTileCache::open(*disk_cache, path, dataset_info.files,
+                                dataset_info.geotransform, tile_size_);
+      }
+    }
+    // The quadtrees and the preloaded masks do not use the caches.
+    auto cached = static_cast<size_t>(std::count_if(
+        base_datasets_.begin(), base_datasets_.end(), [](const auto &item) {
+          return item->dataset && !item->preloaded;
+        }));
+    shared_cache_size_ = std::max<size_t>(
+        1, max_cache_size_ / std::max<size_t>(1, cached) / topology_.size());
+    for (auto &item : base_datasets_) {
+      for (size_t ix = 0; ix < topology_.size(); ++ix) {
+        item->shared_caches.emplace_back(
+            std::make_unique<SharedTileCache>(shared_cache_size_));
+      }
+    }
+    if (readahead) {
+      prefetcher_ = std::make_unique<Prefetcher>(
+          [this](const Prefetcher::Request &request) { prefetch(request); });
     }
   }
 
+  /// @brief Stops the warm-ups running in the background.
+  ~Dataset();
+
   /// @brief Checks if a given point is water.
   ///
   /// This function checks if a given point is water by checking if it is
@@ -68,11 +243,185 @@ class Dataset {
   /// the bounding box of a dataset, the function checks if the point is water
   /// by checking if the value of the dataset at the point is less than 0.
   ///
+  /// Points located outside every dataset, or that cannot be transformed to
+  /// the projection of the datasets containing them, do not raise an error:
+  /// they are set to the fill value.
+  ///
   /// @param[in] lon The longitude of the points.
   /// @param[in] lat The latitude of the points.
   /// @param[in] num_threads The number of threads to use for parallelization.
+  /// @param[in] fill_value The value assigned to the points not covered by
+  /// any dataset. Defaults to false.
+  /// @param[in] espg_code The EPSG code of the coordinates of the points.
+  /// Defaults to the code given to the constructor.
   auto is_water(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
-                size_t num_threads = 0) const -> VectorBool;
+                size_t num_threads = 0, bool fill_value = false,
+                const std::optional<int> &espg_code = std::nullopt) const
+      -> VectorBool;
+
+  /// @brief Checks if the given points are water, one bit per point.
+  ///
+  /// The bits are set by the workers as the chunks are classified, without
+  /// a boolean per point. The result can be unpacked with numpy.unpackbits.
+  ///
+  /// @param[in] lon The longitude of the points.
+  /// @param[in] lat The latitude of the points.
+  /// @param[in] num_threads The number of threads to use for parallelization.
+  /// @param[in] fill_value The value assigned to the points not covered by
+  /// any dataset. Defaults to false.
+  /// @param[in] espg_code The EPSG code of the coordinates of the points.
+  /// Defaults to the code given to the constructor.
+  /// @return The (size + 7) / 8 bytes holding the bits, the first point in
+  /// the most significant bit of the first byte.
+  auto is_water_packed(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                       size_t num_threads = 0, bool fill_value = false,
+                       const std::optional<int> &espg_code = std::nullopt)
+      const -> VectorUInt8;
+
+  /// @brief Gets the index of the water points.
+  ///
+  /// @param[in] lon The longitude of the points.
+  /// @param[in] lat The latitude of the points.
+  /// @param[in] num_threads The number of threads to use for parallelization.
+  /// @param[in] fill_value The value assigned to the points not covered by
+  /// any dataset. Defaults to false.
+  /// @param[in] espg_code The EPSG code of the coordinates of the points.
+  /// Defaults to the code given to the constructor.
+  /// @return The index of the water points, in increasing order.
+  auto water_indices(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                     size_t num_threads = 0, bool fill_value = false,
+                     const std::optional<int> &espg_code = std::nullopt) const
+      -> VectorInt64;
+
+  /// @brief Counts the water points, without allocating a result per point.
+  ///
+  /// @param[in] lon The longitude of the points.
+  /// @param[in] lat The latitude of the points.
+  /// @param[in] num_threads The number of threads to use for parallelization.
+  /// @param[in] fill_value The value assigned to the points not covered by
+  /// any dataset. Defaults to false.
+  /// @param[in] espg_code The EPSG code of the coordinates of the points.
+  /// Defaults to the code given to the constructor.
+  /// @return The number of water points.
+  auto count_water_points(ConstRefVectorFloat64 lon,
+                          ConstRefVectorFloat64 lat, size_t num_threads = 0,
+                          bool fill_value = false,
+                          const std::optional<int> &espg_code =
+                              std::nullopt) const -> uint64_t;
+
+  /// @brief Classifies the points as water, land, nodata or outside.
+  ///
+  /// The datasets are visited in the order given to the constructor. A point
+  /// is water if any dataset covering it says so, otherwise land if any
+  /// dataset covering it says so, otherwise nodata if it falls on a nodata
+  /// pixel of a dataset, otherwise outside. The index of the dataset that
+  /// gave the answer is returned along with the class. The quadtree backend
+  /// stores the water pixels only: its nodata pixels are reported as land.
+  ///
+  /// @param[in] lon The longitude of the points.
+  /// @param[in] lat The latitude of the points.
+  /// @param[in] num_threads The number of threads to use for parallelization.
+  /// @param[in] espg_code The EPSG code of the coordinates of the points.
+  /// Defaults to the code given to the constructor.
+  /// @return A tuple containing the class of each point (see PointClass) and
+  /// the index of the dataset that answered, or -1 for the points outside.
+  auto classify(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                size_t num_threads = 0,
+                const std::optional<int> &espg_code = std::nullopt) const
+      -> std::tuple<VectorUInt8, VectorInt16>;
+
+  /// @brief Computes once the pixel addresses of a set of points.
+  ///
+  /// The points are transformed to each dataset covering them, and the tile
+  /// and the offset in the tile of their pixel are recorded. The result can
+  /// then be evaluated many times, against this object or any Dataset whose
+  /// rasters have the same grids, without transforming the points again.
+  ///
+  /// @param[in] lon The longitude of the points.
+  /// @param[in] lat The latitude of the points.
+  /// @param[in] num_threads The number of threads to use for parallelization.
+  /// @param[in] espg_code The EPSG code of the coordinates of the points.
+  /// Defaults to the code given to the constructor.
+  /// @return The addresses of the points.
+  auto prepare(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+               size_t num_threads = 0,
+               const std::optional<int> &espg_code = std::nullopt) const
+      -> PreparedPoints;
+
+  /// @brief Checks if prepared points are water.
+  ///
+  /// @param[in] points The points prepared by Dataset::prepare.
+  /// @param[in] num_threads The number of threads to use for parallelization.
+  /// @param[in] fill_value The value assigned to the points not covered by
+  /// any dataset. Defaults to false.
+  /// @return True for the water points.
+  /// @throw std::invalid_argument if the grids of the datasets differ from
+  /// the ones the points were prepared for.
+  auto is_water(const PreparedPoints &points, size_t num_threads = 0,
+                bool fill_value = false) const -> VectorBool;
+
+  /// @brief Classifies prepared points as water, land, nodata or outside.
+  ///
+  /// The datasets take precedence over each other as in the classification
+  /// of coordinates. The tiles of each dataset are visited in turn, and the
+  /// pixels of the points they hold are gathered, without a lookup in the
+  /// cache per point.
+  ///
+  /// @param[in] points The points prepared by Dataset::prepare.
+  /// @param[in] num_threads The number of threads to use for parallelization.
+  /// @return A tuple containing the class of each point (see PointClass) and
+  /// the index of the dataset that answered, or -1 for the points outside.
+  /// @throw std::invalid_argument if the grids of the datasets differ from
+  /// the ones the points were prepared for.
+  auto classify(const PreparedPoints &points, size_t num_threads = 0) const
+      -> std::tuple<VectorUInt8, VectorInt16>;
+
+  /// @brief Counts the water pixels located in a box.
+  ///
+  /// The corners of the box are transformed to the projection of each
+  /// dataset, and the pixels of the datasets intersecting the box are counted
+  /// using the rank directory of the bit-packed mask of the dataset. The
+  /// packed mask is built the first time a dataset is involved in a count.
+  /// A pixel lying in several datasets is counted once, by the first dataset
+  /// covering its center, and counted as water if any dataset covering it
+  /// says so, as in the classification of the points.
+  ///
+  /// @param[in] min_lon The minimum longitude of the box.
+  /// @param[in] min_lat The minimum latitude of the box.
+  /// @param[in] max_lon The maximum longitude of the box.
+  /// @param[in] max_lat The maximum latitude of the box.
+  /// @return A tuple containing the number of water pixels and the total
+  /// number of pixels in the box.
+  auto count_water(double min_lon, double min_lat, double max_lon,
+                   double max_lat) const -> std::tuple<uint64_t, uint64_t>;
+
+  /// @brief Loads the tiles of a box into the caches.
+  ///
+  /// The tiles of the datasets intersecting the box are read in batches, as
+  /// the queries do, and stored in the shared cache of every NUMA node, so
+  /// that the first queries of the region do not pay for the cold reads. The
+  /// tiles are selected row by row until the memory budget or the capacity of
+  /// the cache of a dataset is reached.
+  ///
+  /// @param[in] min_lon The minimum longitude of the box.
+  /// @param[in] min_lat The minimum latitude of the box.
+  /// @param[in] max_lon The maximum longitude of the box.
+  /// @param[in] max_lat The maximum latitude of the box.
+  /// @param[in] max_bytes The maximum memory used by the tiles loaded, all
+  /// the nodes included. Defaults to 0, no limit.
+  /// @param[in] background If true, the tiles are loaded by a background
+  /// thread and the function returns immediately, otherwise it returns once
+  /// the tiles are loaded. Defaults to true.
+  /// @return The progress of the warm-up.
+  auto warm(double min_lon, double min_lat, double max_lon, double max_lat,
+            size_t max_bytes = 0, bool background = true) const
+      -> std::shared_ptr<WarmProgress>;
+
+  /// @brief Gets the statistics of the tile loading.
+  ///
+  /// @return The mode of each dataset and the counters accumulated since the
+  /// construction of the object.
+  auto cache_stats() const -> CacheStats;
 
  private:
   /// @brief Represents information about a HydroSHEDS dataset.
@@ -91,6 +440,41 @@ class Dataset {
     size_t x_size;
     /// @brief Size of the dataset in the y-direction.
     size_t y_size;
+    /// @brief Nodata value of the dataset, or -1 if none.
+    int nodata{-1};
+    /// @brief Files holding the dataset, as listed by GDAL.
+    std::vector<std::string> files{};
+    /// @brief Coordinate system of the dataset, in WKT.
+    std::string projection{};
+    /// @brief True if the coordinate system of the dataset is geographic.
+    bool geographic{};
+    /// @brief Optional summary of the dataset used to skip the tile loading
+    /// in uniform regions.
+    std::unique_ptr<MaskPyramid> pyramid{};
+    /// @brief Quadtree holding the whole mask in memory. If set, the GDAL
+    /// dataset pointer is null.
+    std::unique_ptr<LinearQuadtree> quadtree{};
+    /// @brief Bit-packed mask with its rank directory, built on demand to
+    /// answer the count queries, or at construction if the dataset is
+    /// preloaded.
+    std::unique_ptr<PackedMask> packed{};
+    /// @brief Mutex serializing the building of the packed mask, so that the
+    /// raster is decoded without holding the mutex of the dataset.
+    std::unique_ptr<std::mutex> packing{std::make_unique<std::mutex>()};
+    /// @brief Bit-packed nodata pixels of a preloaded dataset, if the dataset
+    /// has a nodata value.
+    std::unique_ptr<PackedMask> nodata_mask{};
+    /// @brief True if the queries are answered from the packed masks.
+    bool preloaded{};
+    /// @brief Direct reader of the tiles, if the layout of the file allows
+    /// it.
+    std::unique_ptr<TiffTileReader> tiff{};
+    /// @brief Decoded tiles persisted between the runs, if enabled.
+    std::unique_ptr<DiskTileCache> disk_cache{};
+    /// @brief True if the GDAL blocks are dropped once copied to a tile.
+    bool drop_blocks{};
+    /// @brief Tile caches shared by the threads, one per NUMA node.
+    std::vector<std::unique_ptr<SharedTileCache>> shared_caches{};
 
     /// @brief Constructs a DatasetInfo object with a GDAL dataset pointer, a
     /// coordinate transformation pointer, geotransform parameters, a mutex, a
@@ -117,45 +501,386 @@ class Dataset {
           y_size(y_size) {}
   };
 
+  /// @brief Transformation of the input coordinates to a dataset.
+  struct Transformer {
+    /// @brief Coordinate transformation, not thread-safe.
+    OGRCoordinateTransformationSmartPtr transform{
+        nullptr, [](OGRCoordinateTransformation *ct) {
+          OCTDestroyCoordinateTransformation(ct);
+        }};
+    /// @brief Approximation of the transformation, if enabled.
+    std::unique_ptr<ApproxTransform> approx{};
+    /// @brief True if the input coordinates can be tested against the
+    /// bounding box of the dataset before being transformed.
+    bool filter_bbox{true};
+    /// @brief True if the input and the dataset are in geographic
+    /// coordinates: the longitudes are wrapped to the range of the dataset.
+    bool wrap_longitude{};
+  };
+
   /// @brief Represents a cache for a HydroSHEDS dataset.
   struct DatsetCache {
     /// @brief Pointer to the dataset information.
     DatasetInfo *dataset_info;
-    /// @brief Tile cache for the dataset.
+    /// @brief Tile cache of the thread, in front of the shared cache.
     TileCache tile_cache;
+    /// @brief Shared tile cache of the NUMA node running the thread.
+    SharedTileCache *shared_cache;
+    /// @brief Arena allocating the tiles of the NUMA node running the thread.
+    TileArena *arena;
+    /// @brief Transformation from the coordinate system given to the
+    /// constructor, owned by the thread.
+    Transformer transformer;
+    /// @brief Transformations from the other coordinate systems requested,
+    /// owned by the thread and indexed by EPSG code.
+    std::unordered_map<int, Transformer> transformers{};
+    /// @brief Index of the dataset.
+    size_t index{};
+    /// @brief NUMA node running the thread.
+    size_t node{};
+    /// @brief Last tile missing from the caches, used to guess the direction
+    /// of travel of the read-ahead.
+    std::optional<TileKey> last_miss{};
 
     /// @brief Constructs a DatsetCache object with a pointer to the dataset
     /// information and a tile cache.
     ///
     /// @param[in] dataset_info Pointer to the dataset information.
     /// @param[in] tile_cache Tile cache for the dataset.
-    DatsetCache(DatasetInfo *dataset_info, TileCache tile_cache)
-        : dataset_info(dataset_info), tile_cache(tile_cache) {}
+    /// @param[in] shared_cache Shared tile cache used on a miss.
+    /// @param[in] arena Arena allocating the tiles loaded.
+    /// @param[in] transform Coordinate transformation of the thread.
+    DatsetCache(DatasetInfo *dataset_info, TileCache tile_cache,
+                SharedTileCache *shared_cache, TileArena *arena,
+                OGRCoordinateTransformationSmartPtr transform)
+        : dataset_info(dataset_info),
+          tile_cache(std::move(tile_cache)),
+          shared_cache(shared_cache),
+          arena(arena),
+          transformer{std::move(transform)} {}
+  };
+
+  /// @brief Coverage of the points of a batch by a dataset, computed from
+  /// the extent of the batch.
+  enum class BatchCoverage : uint8_t {
+    /// @brief No point of the batch is in the dataset: it is not queried.
+    kNone,
+    /// @brief Some points may be in the dataset: each one is tested against
+    /// its bounding box.
+    kPartial,
+    /// @brief All the points are in the bounding box of the dataset: they
+    /// are located without testing the bounding box.
+    kFull,
+  };
+
+  /// @brief Pixel coordinates of the points of a chunk located in a dataset.
+  struct PixelIndices {
+    /// @brief Position of the points in the chunk.
+    std::vector<size_t> index;
+    /// @brief Coordinates of the points in the x-direction.
+    std::vector<double> x;
+    /// @brief Coordinates of the points in the y-direction.
+    std::vector<double> y;
+    /// @brief Status of the coordinate transformation of the points.
+    std::vector<int> success;
+    /// @brief Pixel coordinates of the points in the x-direction.
+    std::vector<size_t> pixel_x;
+    /// @brief Pixel coordinates of the points in the y-direction.
+    std::vector<size_t> pixel_y;
+  };
+
+  /// @brief Buffers used by a worker to process a chunk of points.
+  struct ChunkBuffers {
+    /// @brief Index of the points of the chunk in the input vectors.
+    std::vector<size_t> points;
+    /// @brief Pixel coordinates of the points in the current dataset.
+    PixelIndices indices;
+    /// @brief Class of the points.
+    VectorUInt8 classes;
+    /// @brief Index of the dataset that classified the points.
+    VectorInt16 datasets;
+    /// @brief Index of the points selected by the worker, in the order of
+    /// its chunks.
+    std::vector<int64_t> selected;
+    /// @brief Tiles missing from the caches.
+    std::vector<TileKey> missing;
+    /// @brief Tiles of the batch missing from the shared cache.
+    std::vector<TileKey> shared_misses;
+    /// @brief Tiles read together.
+    std::vector<TiffTileReader::TileRead> reads;
+    /// @brief Buffers of the tiles read together.
+    std::vector<std::shared_ptr<char[]>> slots;
+    /// @brief Pixels of adjacent tiles read at once through GDAL.
+    std::vector<char> strip;
   };
 
+  /// @brief State of a thread querying the datasets.
+  ///
+  /// The contexts are kept in a pool between the calls, so that the caches,
+  /// the coordinate transformations and the buffers are only allocated the
+  /// first time a thread needs them.
+  struct QueryContext {
+    /// @brief NUMA node the context belongs to.
+    size_t node;
+    /// @brief Caches of the datasets.
+    std::vector<DatsetCache> cache;
+    /// @brief Buffers of the chunk being processed.
+    ChunkBuffers buffers{};
+    /// @brief Node owning each point, used to dispatch the points.
+    std::vector<uint16_t> owners{};
+    /// @brief Index of the points handled by each node.
+    std::vector<std::vector<size_t>> node_points{};
+  };
+
+  /// @brief Context borrowed from the pool, given back when released.
+  using QueryContextPtr =
+      std::unique_ptr<QueryContext, std::function<void(QueryContext *)>>;
+
   /// @brief List of base datasets handled by the object.
   std::vector<std::unique_ptr<DatasetInfo>> base_datasets_;
 
   /// @brief Size of the tiles used to cache the datasets.
   size_t tile_size_;
 
-  /// @brief Maximum number of tiles that the cache can hold.
+  /// @brief Maximum number of tiles held by the shared caches of all the
+  /// datasets and nodes.
   size_t max_cache_size_;
 
+  /// @brief Maximum number of tiles held by the shared cache of a dataset on
+  /// a node.
+  size_t shared_cache_size_{};
+
   /// @brief ESPG code used to transform the input coordinates to the dataset's
   /// projection.
   int espg_code_;
 
+  /// @brief Policy applied to the GDAL block cache.
+  BlockCacheMode block_cache_;
+
+  /// @brief Maximum error of the approximate transformations, in pixels, or
+  /// 0 to use the exact transformations.
+  double max_transform_error_;
+
+  /// @brief Number of tiles decoded without GDAL.
+  mutable std::atomic<uint64_t> direct_reads_{0};
+
+  /// @brief Number of tiles read through GDAL.
+  mutable std::atomic<uint64_t> gdal_reads_{0};
+
+  /// @brief Number of blocks dropped from the GDAL block cache.
+  mutable std::atomic<uint64_t> dropped_blocks_{0};
+
+  /// @brief Number of tiles found in the shared caches.
+  mutable std::atomic<uint64_t> shared_hits_{0};
+
+  /// @brief Number of batches of tiles read together without GDAL.
+  mutable std::atomic<uint64_t> batches_{0};
+
+  /// @brief Number of GDAL reads covering several adjacent tiles.
+  mutable std::atomic<uint64_t> coalesced_reads_{0};
+
+  /// @brief Number of tiles mapped from the disk caches.
+  mutable std::atomic<uint64_t> disk_hits_{0};
+
+  /// @brief Number of tiles written to the disk caches.
+  mutable std::atomic<uint64_t> disk_writes_{0};
+
+  /// @brief Maximum number of adjacent tiles read by a single GDAL call.
+  static constexpr size_t kMaxTileRun = 8;
+
+  /// @brief NUMA nodes used to place the threads and the caches. Holds a
+  /// single node if the NUMA placement is disabled.
+  NumaTopology topology_;
+
+  /// @brief Arenas allocating the tiles, one per NUMA node.
+  std::vector<std::unique_ptr<TileArena>> arenas_{};
+
+  /// @brief Mutex protecting the pool of contexts.
+  std::unique_ptr<std::mutex> contexts_mutex_{std::make_unique<std::mutex>()};
+
+  /// @brief Contexts not used by a thread, for each NUMA node.
+  mutable std::vector<std::vector<std::unique_ptr<QueryContext>>>
+      idle_contexts_{};
+
+  /// @brief Mutex protecting the registry of the transformations.
+  std::unique_ptr<std::mutex> registry_mutex_{std::make_unique<std::mutex>()};
+
+  /// @brief Transformations from the coordinate systems requested by the
+  /// callers to each dataset, indexed by EPSG code. The threads clone them.
+  mutable std::unordered_map<int, std::vector<Transformer>> registry_{};
+
+  /// @brief Mutex protecting the warm-ups running in the background.
+  std::unique_ptr<std::mutex> warm_mutex_{std::make_unique<std::mutex>()};
+
+  /// @brief Warm-ups started in the background, with their threads.
+  mutable std::vector<std::pair<std::shared_ptr<WarmProgress>, std::thread>>
+      warm_jobs_{};
+
+  /// @brief Number of tiles read together by a warm-up.
+  static constexpr size_t kWarmBatchSize = 64;
+
+  /// @brief Number of segments of each edge of a box transformed to the
+  /// coordinate system of a dataset.
+  static constexpr size_t kEdgeSamples = 16;
+
+  /// @brief Loads the tiles ahead of the queries, if enabled. Declared last
+  /// to stop its thread before the datasets are released.
+  std::unique_ptr<Prefetcher> prefetcher_{};
+
+  /// @brief Maximum number of tiles held by the private cache of a thread.
+  static constexpr size_t kLocalCacheSize = 64;
+
   /// @brief Determines the properties of a HydroSHEDS dataset.
   /// @param[in] path The path to the HydroSHEDS dataset.
   /// @return A pointer to a DatasetInfo object.
   auto init_dataset_info(const std::string &path)
       -> std::unique_ptr<DatasetInfo>;
 
+  /// @brief Loads a linear quadtree written by build_quadtree.
+  /// @param[in] path The path to the quadtree file.
+  /// @return A pointer to a DatasetInfo object.
+  auto init_quadtree_info(const std::string &path)
+      -> std::unique_ptr<DatasetInfo>;
+
+  /// @brief Loads or builds the mask pyramid of a dataset.
+  /// @param[in] path The path to the HydroSHEDS dataset.
+  /// @param[in] directory The directory holding the pyramid files, or an empty
+  /// string to keep the pyramid in memory only.
+  /// @param[in,out] dataset_info The dataset to attach the pyramid to.
+  static auto init_pyramid(const std::string &path,
+                           const std::string &directory,
+                           DatasetInfo &dataset_info) -> void;
+
+  /// @brief Decodes a dataset into bit-packed masks.
+  ///
+  /// The rows are decoded in bands of one tile by several threads, each
+  /// reading the tiles directly or through its own GDAL dataset handle: the
+  /// dataset handle shared by the queries is not used.
+  ///
+  /// @param[in] dataset_info The dataset to decode.
+  /// @param[out] water The mask receiving the water pixels.
+  /// @param[out] nodata_mask The mask receiving the nodata pixels, or null.
+  auto decode_masks(const DatasetInfo &dataset_info, PackedMask &water,
+                    PackedMask *nodata_mask) const -> void;
+
+  /// @brief Decodes a dataset into bit-packed masks held in memory.
+  /// @param[in,out] dataset_info The dataset to preload.
+  auto preload_masks(DatasetInfo &dataset_info) const -> void;
+
+  /// @brief Gets the bit-packed mask of a dataset, building it if necessary.
+  /// @param[in,out] dataset_info The dataset to get the mask of.
+  /// @return The packed mask, with its rank directory.
+  auto packed_mask(DatasetInfo &dataset_info) const -> const PackedMask &;
+
+  /// @brief Corrects the count of a window of a dataset for the pixels lying
+  /// in other datasets.
+  ///
+  /// The center of each pixel of the window is looked up in the other
+  /// datasets whose extent may cover it. A pixel covered by a previous
+  /// dataset is left to that dataset, and a pixel counted as land is counted
+  /// as water if a dataset covering it says so, as in the classification.
+  ///
+  /// @param[in] index The index of the dataset.
+  /// @param[in] window The first column, first row, last column and last row
+  /// (both excluded) of the window.
+  /// @param[in] candidates True for the datasets intersecting the box
+  /// counted.
+  /// @return The number of water pixels and the number of pixels to add to
+  /// the counts of the window.
+  auto count_overlaps(size_t index, const std::array<size_t, 4> &window,
+                      const std::vector<bool> &candidates) const
+      -> std::tuple<int64_t, int64_t>;
+
   /// @brief Allocates a cache for the datasets.
-  /// @param[in] num_threads The number of threads to use for parallelization.
+  /// @param[in] node The NUMA node running the thread using the cache.
   /// @return A vector of DatasetCache objects.
-  auto allocate_cache(size_t num_threads) const -> std::vector<DatsetCache>;
+  auto allocate_cache(size_t node) const -> std::vector<DatsetCache>;
+
+  /// @brief Borrows a context from the pool, creating it if none is idle.
+  /// @param[in] node The NUMA node running the thread using the context.
+  /// @return The context, given back to the pool when released.
+  auto acquire_context(size_t node) const -> QueryContextPtr;
+
+  /// @brief Gets a tile from the shared cache, updating the statistics.
+  /// @param[in,out] dataset_cache The cache of the dataset.
+  /// @param[in] tile_key The key of the tile.
+  /// @return The tile, or a null pointer if it is not cached.
+  auto find_shared_tile(DatsetCache &dataset_cache,
+                        const TileKey &tile_key) const -> Tile;
+
+  /// @brief Queues the neighbours of the tiles missing from the shared cache
+  /// for the read-ahead, once per batch and within a single budget.
+  /// @param[in,out] dataset_cache The cache of the dataset.
+  /// @param[in] misses The tiles of the batch missing from the shared cache.
+  /// @param[in] batch The tiles loaded by the batch, sorted by row, which are
+  /// never queued.
+  auto read_ahead(DatsetCache &dataset_cache, std::span<const TileKey> misses,
+                  std::span<const TileKey> batch) const -> void;
+
+  /// @brief Loads a tile requested by the read-ahead into the shared cache.
+  /// @param[in] request The tile to load.
+  auto prefetch(const Prefetcher::Request &request) const -> void;
+
+  /// @brief Maps a tile from the disk cache of a dataset.
+  /// @param[in] dataset_info The dataset.
+  /// @param[in] tile_key The key of the tile.
+  /// @return The tile, or a null pointer if the disk cache is disabled or
+  /// does not hold the tile.
+  auto find_disk_tile(const DatasetInfo &dataset_info,
+                      const TileKey &tile_key) const -> Tile;
+
+  /// @brief Reads a tile from a dataset, and writes it to the disk cache.
+  /// @param[in] dataset_info The dataset to read.
+  /// @param[in] arena The arena allocating the tile.
+  /// @param[in] tile_key The key of the tile.
+  /// @return The tile.
+  auto read_tile(DatasetInfo &dataset_info, TileArena &arena,
+                 const TileKey &tile_key) const -> Tile;
+
+  /// @brief Reads the tiles listed in buffers.reads into buffers.slots, in a
+  /// single batch, and adds them to the caches.
+  /// @param[in,out] dataset_cache The cache of the dataset.
+  /// @param[in,out] buffers The buffers holding the tiles to read.
+  auto read_tiles(DatsetCache &dataset_cache, ChunkBuffers &buffers) const
+      -> void;
+
+  /// @brief Loads the tiles selected by a warm-up into the shared caches of
+  /// every node.
+  ///
+  /// On a machine with several nodes, the nodes are loaded concurrently by
+  /// one thread each, pinned to its node.
+  ///
+  /// @param[in] tiles The tiles to load, for each dataset.
+  /// @param[in,out] progress The progress of the warm-up.
+  /// @param[in] pin If true, the calling thread is pinned to the node when
+  /// it loads the tiles of a single node itself.
+  auto load_tiles(const std::vector<std::vector<TileKey>> &tiles,
+                  WarmProgress &progress, bool pin) const -> void;
+
+  /// @brief Loads the tiles selected by a warm-up into the shared caches of
+  /// a node.
+  /// @param[in] tiles The tiles to load, for each dataset.
+  /// @param[in,out] progress The progress of the warm-up.
+  /// @param[in] node The node whose caches receive the tiles.
+  /// @param[in] pin If true, the calling thread is pinned to the node.
+  /// @param[in] failed Set when the loader of another node has failed.
+  auto load_node_tiles(const std::vector<std::vector<TileKey>> &tiles,
+                       WarmProgress &progress, size_t node, bool pin,
+                       const std::atomic<bool> &failed) const -> void;
+
+  /// @brief Converts a box to the pixels of a dataset.
+  /// @param[in] dataset_info The dataset.
+  /// @param[in] min_lon The minimum longitude of the box.
+  /// @param[in] min_lat The minimum latitude of the box.
+  /// @param[in] max_lon The maximum longitude of the box.
+  /// @param[in] max_lat The maximum latitude of the box.
+  /// @return The first column, first row, last column and last row (both
+  /// excluded) of the pixels covered: two windows if the box crosses the
+  /// end of the longitudes of a geographic dataset, none if the box misses
+  /// the dataset or cannot be transformed to its coordinate system.
+  auto pixel_window(DatasetInfo &dataset_info, double min_lon, double min_lat,
+                    double max_lon, double max_lat) const
+      -> std::vector<std::array<size_t, 4>>;
 
   /// @brief Loads a tile from the cache.
   /// @param[in] tile_key The key of the tile to load.
@@ -163,22 +888,209 @@ class Dataset {
   auto load_tile_cache(const TileKey &tile_key,
                        DatsetCache &dataset_cache) const -> void;
 
-  /// @brief Determines if a point is water.
-  /// @param[in] lon Longitude of the point.
-  /// @param[in] lat Latitude of the point.
-  /// @param[in,out] dataset_cache_collection Collection of dataset caches.
-  /// @return True if the point is water, false otherwise.
-  auto is_water(double lon, double lat,
-                std::vector<DatsetCache> &dataset_cache_collection) const
-      -> bool;
-
-  /// @brief Determines if a point is water.
-  /// @param[in] lon Longitude of the point.
-  /// @param[in] lat Latitude of the point.
-  /// @param[in,out] dataset_cache Collection of dataset caches.
-  /// @return True if the point is water, false otherwise.
-  auto is_water(double lon, double lat,
-                DatsetCache &dataset_cache) const -> bool;
+  /// @brief Number of points processed at once by a worker.
+  static constexpr size_t kChunkSize = 4096;
+
+  /// @brief Gets the transformations from a coordinate system to the
+  /// datasets, creating them the first time the system is requested.
+  /// @param[in] espg_code The EPSG code of the coordinate system.
+  /// @return The transformation to each dataset.
+  auto registered_transforms(int espg_code) const
+      -> const std::vector<Transformer> &;
+
+  /// @brief Gets the transformation of a thread from a coordinate system to
+  /// a dataset, cloning the registered one the first time.
+  /// @param[in,out] dataset_cache The cache of the dataset of the thread.
+  /// @param[in] espg_code The EPSG code of the coordinate system.
+  /// @return The transformation.
+  auto select_transformer(DatsetCache &dataset_cache, int espg_code) const
+      -> Transformer &;
+
+  /// @brief Resolves the coordinate system of a query.
+  /// @param[in] espg_code The EPSG code requested, if any.
+  /// @return The EPSG code of the coordinates of the points.
+  /// @throw std::runtime_error if the code is invalid.
+  auto resolve_espg_code(const std::optional<int> &espg_code) const -> int;
+
+  /// @brief Computes the pixel coordinates of a chunk of points in a dataset.
+  ///
+  /// The points outside the bounding box of the dataset, that fail to be
+  /// transformed, or that map outside the raster are masked out: only the
+  /// points mapping to a valid pixel are kept in the result.
+  ///
+  /// @param[in] dataset_cache The cache of the dataset to locate the points
+  /// in.
+  /// @param[in] transformer The transformation of the coordinates of the
+  /// points to the dataset.
+  /// @param[in] lon Longitude of the points.
+  /// @param[in] lat Latitude of the points.
+  /// @param[in] points Index of the points of the chunk.
+  /// @param[in] inside True if all the points are known to be in the
+  /// bounding box of the dataset, which is then not tested.
+  /// @param[out] indices Pixel coordinates of the valid points.
+  auto locate(const DatsetCache &dataset_cache, const Transformer &transformer,
+              ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+              const std::vector<size_t> &points, bool inside,
+              PixelIndices &indices) const -> void;
+
+  /// @brief Computes the coverage of a batch of points by each dataset.
+  ///
+  /// The extent of the batch is computed in a single vectorized pass, then
+  /// compared to the bounding box of each dataset: the datasets it does not
+  /// intersect are skipped for the whole batch, and the points are not
+  /// tested against the bounding box of a dataset covering the whole
+  /// extent. The datasets in another coordinate system than the points are
+  /// always partially covered.
+  ///
+  /// @param[in] lon Longitude of the points.
+  /// @param[in] lat Latitude of the points.
+  /// @param[in] espg_code The EPSG code of the coordinates of the points.
+  /// @return The coverage of the batch by each dataset.
+  auto batch_coverage(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                      int espg_code) const -> std::vector<BatchCoverage>;
+
+  /// @brief Dispatches the points to the NUMA nodes.
+  ///
+  /// A point is sent to the node owning the tile holding it in the first
+  /// dataset covering it, so that each tile is cached on a single node.
+  ///
+  /// @param[in] lon Longitude of the points.
+  /// @param[in] lat Latitude of the points.
+  /// @param[in] espg_code The EPSG code of the coordinates of the points.
+  /// @param[in] num_threads The number of threads to use for parallelization.
+  /// @param[in,out] context The context receiving the index of the points
+  /// handled by each node.
+  auto dispatch_to_nodes(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                         int espg_code, size_t num_threads,
+                         QueryContext &context) const -> void;
+
+  /// @brief Reads a window of a dataset through GDAL, then drops the blocks
+  /// read from the GDAL block cache if requested. The mutex of the dataset
+  /// must be held.
+  ///
+  /// @param[in] dataset_info The dataset to read.
+  /// @param[in] x_offset The first column of the window.
+  /// @param[in] y_offset The first row of the window.
+  /// @param[in] width The number of columns of the window.
+  /// @param[in] height The number of rows of the window.
+  /// @param[out] buffer The buffer receiving the pixels.
+  /// @param[in] line_space The distance between two rows in the buffer.
+  auto read_window(const DatasetInfo &dataset_info, size_t x_offset,
+                   size_t y_offset, size_t width, size_t height, char *buffer,
+                   size_t line_space) const -> void;
+
+  /// @brief Reads the tiles of a batch through GDAL, merging the adjacent
+  /// tiles of a row into a single read.
+  ///
+  /// @param[in] dataset_info The dataset to read.
+  /// @param[in,out] buffers The chunk being processed, holding the tiles to
+  /// read sorted by row.
+  auto read_tile_runs(const DatasetInfo &dataset_info,
+                      ChunkBuffers &buffers) const -> void;
+
+  /// @brief Loads together the tiles of a dataset missing to classify a
+  /// chunk of points.
+  ///
+  /// The tiles are read in a single batch instead of one at a time as the
+  /// points are classified: through the direct reader if possible, or by
+  /// GDAL reads merging the adjacent tiles. At most as many tiles as the
+  /// cache of the thread can hold are loaded, the others are loaded one at
+  /// a time.
+  ///
+  /// @param[in,out] dataset_cache The cache of the dataset.
+  /// @param[in] classes The classes already assigned to the points.
+  /// @param[in,out] buffers The chunk being processed, holding the pixel
+  /// coordinates of the points in the dataset.
+  auto load_missing_tiles(DatsetCache &dataset_cache,
+                          const VectorUInt8 &classes,
+                          ChunkBuffers &buffers) const -> void;
+
+  /// @brief Classifies a chunk of points.
+  /// @param[in] lon Longitude of the points.
+  /// @param[in] lat Latitude of the points.
+  /// @param[in] espg_code The EPSG code of the coordinates of the points.
+  /// @param[in] coverage The coverage of the batch by each dataset.
+  /// @param[in,out] cache The caches of the datasets.
+  /// @param[in,out] buffers The chunk to process and its results.
+  auto classify_chunk(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                      int espg_code, const std::vector<BatchCoverage> &coverage,
+                      std::vector<DatsetCache> &cache,
+                      ChunkBuffers &buffers) const -> void;
+
+  /// @brief Classifies the points of the input vectors.
+  ///
+  /// The points are processed by chunks; the buffers of each chunk, holding
+  /// the index of its points, their classes and the indexes of the datasets
+  /// that answered, are handed to a callback, in the same pass.
+  ///
+  /// @tparam Store The type of the callback called with the buffers of a
+  /// chunk.
+  /// @param[in] lon Longitude of the points.
+  /// @param[in] lat Latitude of the points.
+  /// @param[in] num_threads The number of threads to use for parallelization.
+  /// @param[in] espg_code The EPSG code of the coordinates of the points.
+  /// @param[in] store The callback receiving the results.
+  template <typename Store>
+  auto classify(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                size_t num_threads, int espg_code, const Store &store) const
+      -> void;
+
+  /// @brief Classifies the points of the input vectors, handing the buffers
+  /// of each worker to a callback once its chunks are stored.
+  ///
+  /// The points selected by the store callback are collected by the worker
+  /// in ChunkBuffers::selected, emptied before its first chunk.
+  ///
+  /// @tparam Store The type of the callback called with the buffers of a
+  /// chunk.
+  /// @tparam Finish The type of the callback called with the index of the
+  /// first point handled by a worker and its buffers.
+  /// @param[in] lon Longitude of the points.
+  /// @param[in] lat Latitude of the points.
+  /// @param[in] num_threads The number of threads to use for parallelization.
+  /// @param[in] espg_code The EPSG code of the coordinates of the points.
+  /// @param[in] store The callback receiving the results.
+  /// @param[in] finish The callback receiving the buffers of the workers.
+  template <typename Store, typename Finish>
+  auto classify(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                size_t num_threads, int espg_code, const Store &store,
+                const Finish &finish) const -> void;
+
+  /// @brief Classifies the prepared points of a tile of a dataset.
+  ///
+  /// @param[in] points The prepared points.
+  /// @param[in] group The points of the tile.
+  /// @param[in] index The index of the dataset.
+  /// @param[in,out] dataset_cache The cache of the dataset.
+  /// @param[in,out] classes The class of each point.
+  /// @param[in,out] datasets The index of the dataset that answered for
+  /// each point.
+  auto classify_group(const PreparedPoints &points,
+                      const PreparedPoints::TileGroup &group, size_t index,
+                      DatsetCache &dataset_cache, VectorUInt8 &classes,
+                      VectorInt16 &datasets) const -> void;
+
+  /// @brief Classifies a pixel.
+  /// @param[in] pixel_x Pixel coordinate in the x-direction, in the raster.
+  /// @param[in] pixel_y Pixel coordinate in the y-direction, in the raster.
+  /// @param[in,out] dataset_cache Cache of the dataset holding the pixel.
+  /// @return The class of the pixel: water, land or nodata.
+  auto classify(size_t pixel_x, size_t pixel_y,
+                DatsetCache &dataset_cache) const -> PointClass;
 };
 
+/// @brief Encodes a HydroSHEDS dataset as a linear quadtree.
+///
+/// The file written can be passed to the Dataset constructor in place of the
+/// GeoTIFF file to answer the queries from memory.
+///
+/// @param[in] path The path to the HydroSHEDS dataset.
+/// @param[in] output The path to the quadtree file to write. The extension
+/// should be ".lqt".
+inline auto build_quadtree(const std::string &path,
+                           const std::string &output) -> void {
+  GDALAllRegister();
+  LinearQuadtree::build(path).save(output);
+}
+
 }  // namespace hydrosheds
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hydrosheds/tile_cache.hpp"
+
+namespace hydrosheds {
+
+/// @brief Cache of decoded tiles persisted on disk between the runs.
+///
+/// Each dataset owns a subdirectory of the cache directory, named after a
+/// hash of the path of the dataset. A tile is written there, decoded, the
+/// first time it is read from the dataset, and mapped in memory by the
+/// following runs instead of being read and decompressed again. The
+/// subdirectory records the identity of the dataset: the path, size and
+/// modification time of each of its files, for example the sources of a VRT,
+/// its geotransform and the size of the tiles. The tiles are discarded when
+/// the identity changes, so a stale tile is never served.
+///
+/// The files are written under a temporary name then renamed, so several
+/// processes can share the directory.
+class DiskTileCache {
+ public:
+  /// @brief Opens the cache of a dataset.
+  ///
+  /// @param[in] directory The cache directory, created if necessary.
+  /// @param[in] path The path to the dataset.
+  /// @param[in] files The files of the dataset, as returned by
+  /// GDALDataset::GetFileList.
+  /// @param[in] geotransform The geotransform of the dataset.
+  /// @param[in] tile_size The size of the tiles.
+  /// @return The cache, or a null pointer if a file of the dataset is not a
+  /// local file or the platform does not support the memory mapping.
+  static auto open(const std::string &directory, const std::string &path,
+                   const std::vector<std::string> &files,
+                   const std::array<double, 6> &geotransform, size_t tile_size)
+      -> std::unique_ptr<DiskTileCache>;
+
+  /// @brief Maps a tile stored by a previous run.
+  ///
+  /// @param[in] key The key of the tile.
+  /// @return The tile, or a null pointer if it is not stored.
+  auto load(const TileKey &key) const -> Tile;
+
+  /// @brief Stores a tile. The cache is best effort: a tile that cannot be
+  /// written is read again from the dataset by the next runs.
+  ///
+  /// @param[in] key The key of the tile.
+  /// @param[in] tile The tile_size * tile_size pixels of the tile.
+  /// @return True if the tile was written.
+  auto store(const TileKey &key, const char *tile) const -> bool;
+
+ private:
+  /// @brief Directory holding the tiles of the dataset.
+  std::filesystem::path directory_;
+  /// @brief Size of a tile, in bytes.
+  size_t tile_bytes_;
+
+  /// @brief Wraps the directory of a dataset.
+  /// @param[in] directory The directory holding the tiles.
+  /// @param[in] tile_bytes The size of a tile, in bytes.
+  DiskTileCache(std::filesystem::path directory, size_t tile_bytes)
+      : directory_(std::move(directory)), tile_bytes_(tile_bytes) {}
+
+  /// @brief Gets the path of the file holding a tile.
+  /// @param[in] key The key of the tile.
+  /// @return The path of the file.
+  auto tile_path(const TileKey &key) const -> std::filesystem::path;
+};
+
+}  // namespace hydrosheds
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace hydrosheds {
+
+/// @brief Computes the distance to the coast of every pixel of a HydroSHEDS
+/// mask and writes it to a GeoTIFF file.
+///
+/// The mask is processed tile by tile, in parallel. Each tile is read with a
+/// halo wide enough to contain every pixel located at less than
+/// max_distance from the tile, so that the coasts of the neighbouring tiles
+/// are taken into account. The distance of a pixel is the distance to the
+/// nearest pixel of the other class (land for a water pixel, water for a land
+/// pixel), computed with an exact Euclidean distance transform on the local
+/// equirectangular approximation of the ellipsoid when the mask is in a
+/// geographic coordinate system. Distances greater than max_distance are
+/// clamped to max_distance. The halo of a geographic mask covering the 360
+/// degrees of longitude wraps around the antimeridian. To bound the memory
+/// used, the halo is limited to 4096 pixels on each side of a tile: the
+/// pixels further away are ignored when the pixels are too small for the
+/// halo to cover max_distance, for example near the poles.
+///
+/// The output is a tiled, DEFLATE compressed, Float32 GeoTIFF sharing the
+/// grid of the mask, whose values are in meters (or in the units of the
+/// projection for a projected mask).
+///
+/// @param[in] path The path to the HydroSHEDS mask.
+/// @param[in] output The path to the GeoTIFF file to write.
+/// @param[in] max_distance The maximum distance computed, in meters.
+/// @param[in] tile_size The size of the tiles processed and written, a
+/// multiple of 16.
+/// @param[in] num_threads The number of threads to use for parallelization.
+/// @throw std::invalid_argument if tile_size is not a multiple of 16.
+auto build_distance_to_coast(const std::string &path,
+                             const std::string &output, double max_distance,
+                             size_t tile_size, size_t num_threads) -> void;
+
+}  // namespace hydrosheds
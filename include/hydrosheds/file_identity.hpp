@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace hydrosheds {
+
+/// @brief Seed of the 64-bit FNV-1a hash.
+constexpr uint64_t kFnvSeed = 14695981039346656037ULL;
+
+/// @brief Hashes a buffer with the 64-bit FNV-1a function.
+/// @param[in] data The buffer to hash.
+/// @param[in] size The size of the buffer, in bytes.
+/// @param[in] hash The hash of the previous buffers, to chain the calls.
+/// @return The hash.
+inline auto fnv1a(const void *data, size_t size, uint64_t hash = kFnvSeed)
+    -> uint64_t {
+  const auto *bytes = static_cast<const unsigned char *>(data);
+  for (size_t ix = 0; ix < size; ++ix) {
+    hash = (hash ^ bytes[ix]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+/// @brief Formats a hash as 16 hexadecimal digits.
+/// @param[in] value The hash.
+/// @return The hexadecimal digits.
+inline auto to_hex(uint64_t value) -> std::string {
+  static constexpr char kDigits[] = "0123456789abcdef";
+  auto result = std::string(16, '0');
+  for (auto ix = result.size(); ix-- > 0; value >>= 4U) {
+    result[ix] = kDigits[value & 0xFU];
+  }
+  return result;
+}
+
+/// @brief Hashes the absolute path of a file.
+/// @param[in] path The path to the file.
+/// @return The hash, or nothing if the path cannot be made absolute.
+auto path_hash(const std::string &path) -> std::optional<uint64_t>;
+
+/// @brief Hashes the identity of the files holding a raster.
+///
+/// The absolute path, the size and the modification time of every file are
+/// hashed with the geotransform of the raster: the hash changes as soon as
+/// one of the files, for example a raster referenced by a VRT, is modified.
+///
+/// @param[in] files The files of the raster, as returned by
+/// GDALDataset::GetFileList.
+/// @param[in] geotransform The geotransform of the raster.
+/// @return The hash, or nothing if a file is not a local file.
+auto raster_identity(const std::vector<std::string> &files,
+                     const std::array<double, 6> &geotransform)
+    -> std::optional<uint64_t>;
+
+}  // namespace hydrosheds
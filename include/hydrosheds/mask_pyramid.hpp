@@ -0,0 +1,135 @@
+#pragma once
+
+#include <gdal_priv.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hydrosheds {
+
+/// @brief Summary of the pixels covered by a cell of the mask pyramid.
+enum class Coverage : uint8_t {
+  /// @brief All the pixels of the cell are land.
+  kLand = 0,
+  /// @brief All the pixels of the cell are water.
+  kWater = 1,
+  /// @brief The cell contains both land and water pixels.
+  kMixed = 2,
+};
+
+/// @brief Multi-resolution summary of a water mask.
+///
+/// The pyramid stores, for cells of 16x16, 256x256 and 4096x4096 pixels,
+/// whether the cell is entirely land, entirely water or mixed. A lookup
+/// descends from the coarsest level and stops at the first uniform cell, so
+/// points located in uniform regions are answered without reading the
+/// full-resolution raster.
+class MaskPyramid {
+ public:
+  /// @brief Number of pixels covered by a cell along each axis, from the
+  /// finest to the coarsest level.
+  static constexpr std::array<size_t, 3> kFactors = {16, 256, 4096};
+
+  /// @brief Constructs an empty pyramid for a raster of the given size.
+  ///
+  /// @param[in] x_size The size of the raster in the x-direction.
+  /// @param[in] y_size The size of the raster in the y-direction.
+  MaskPyramid(size_t x_size, size_t y_size);
+
+  /// @brief Builds the pyramid by streaming the raster band row by row.
+  ///
+  /// Cells containing a nodata pixel are always mixed, so that the nodata
+  /// pixels are read from the full-resolution raster.
+  ///
+  /// @param[in] band The raster band holding the water mask.
+  /// @param[in] x_size The size of the raster in the x-direction.
+  /// @param[in] y_size The size of the raster in the y-direction.
+  /// @param[in] nodata The nodata value of the raster, or -1 if none.
+  /// @return The pyramid describing the raster.
+  static auto build(GDALRasterBand *band, size_t x_size, size_t y_size,
+                    int nodata) -> MaskPyramid;
+
+  /// @brief Loads a pyramid previously written by save.
+  ///
+  /// The sizes stored in the file are checked before the levels are
+  /// allocated.
+  ///
+  /// @param[in] path The path to the file to read.
+  /// @param[in] x_size The size of the raster in the x-direction.
+  /// @param[in] y_size The size of the raster in the y-direction.
+  /// @param[in] identity The identity of the raster described, see
+  /// raster_identity.
+  /// @return The pyramid stored in the file.
+  /// @throw std::runtime_error if the file is invalid or describes another
+  /// raster, or another version of the raster.
+  static auto load(const std::string &path, size_t x_size, size_t y_size,
+                   uint64_t identity) -> MaskPyramid;
+
+  /// @brief Writes the pyramid to a file.
+  ///
+  /// @param[in] path The path to the file to write.
+  /// @param[in] identity The identity of the raster described, checked when
+  /// the file is loaded.
+  auto save(const std::string &path, uint64_t identity) const -> void;
+
+  /// @brief Gets the size of the raster described in the x-direction.
+  ///
+  /// @return The size of the raster in the x-direction.
+  constexpr auto x_size() const noexcept -> size_t { return x_size_; }
+
+  /// @brief Gets the size of the raster described in the y-direction.
+  ///
+  /// @return The size of the raster in the y-direction.
+  constexpr auto y_size() const noexcept -> size_t { return y_size_; }
+
+  /// @brief Gets the coverage of the coarsest uniform cell containing a pixel.
+  ///
+  /// @param[in] pixel_x The x-coordinate of the pixel.
+  /// @param[in] pixel_y The y-coordinate of the pixel.
+  /// @return kLand or kWater if a uniform cell contains the pixel, kMixed if
+  /// the full-resolution raster must be read to answer.
+  inline auto lookup(size_t pixel_x, size_t pixel_y) const noexcept
+      -> Coverage {
+    if (pixel_x >= x_size_ || pixel_y >= y_size_) {
+      return Coverage::kMixed;
+    }
+    for (auto ix = levels_.size(); ix-- > 0;) {
+      const auto &level = levels_[ix];
+      auto cell = static_cast<Coverage>(
+          level.cells[(pixel_y / level.factor) * level.x_size +
+                      pixel_x / level.factor]);
+      if (cell != Coverage::kMixed) {
+        return cell;
+      }
+    }
+    return Coverage::kMixed;
+  }
+
+ private:
+  /// @brief Represents one level of the pyramid.
+  struct Level {
+    /// @brief Number of pixels covered by a cell along each axis.
+    size_t factor;
+    /// @brief Number of cells in the x-direction.
+    size_t x_size;
+    /// @brief Number of cells in the y-direction.
+    size_t y_size;
+    /// @brief Coverage of the cells, stored row by row.
+    std::vector<uint8_t> cells;
+  };
+
+  /// @brief Size of the raster in the x-direction.
+  size_t x_size_;
+  /// @brief Size of the raster in the y-direction.
+  size_t y_size_;
+  /// @brief Levels of the pyramid, from the finest to the coarsest.
+  std::array<Level, kFactors.size()> levels_;
+
+  /// @brief Computes the coarse levels from the finest one.
+  auto reduce() -> void;
+};
+
+}  // namespace hydrosheds
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace hydrosheds {
+
+/// @brief Describes the NUMA nodes of the machine and the CPUs attached to
+/// them.
+class NumaTopology {
+ public:
+  /// @brief Constructs a topology made of a single node whose CPUs are
+  /// unknown.
+  NumaTopology() : nodes_(1) {}
+
+  /// @brief Detects the NUMA topology of the machine.
+  ///
+  /// On Linux, the online nodes are read from /sys/devices/system/node, and
+  /// the nodes without CPUs are left out. Elsewhere, or if the information is
+  /// not available, the machine is described as a single node.
+  ///
+  /// @return The topology of the machine.
+  static auto detect() -> NumaTopology;
+
+  /// @brief Gets the number of NUMA nodes.
+  ///
+  /// @return The number of nodes, at least 1.
+  inline auto size() const noexcept -> size_t { return nodes_.size(); }
+
+  /// @brief Gets the CPUs attached to a node.
+  ///
+  /// @param[in] node The index of the node.
+  /// @return The indexes of the CPUs, empty if unknown.
+  inline auto cpus(size_t node) const noexcept -> const std::vector<int> & {
+    return nodes_[node];
+  }
+
+  /// @brief Pins the calling thread to the CPUs of a node.
+  ///
+  /// Memory first touched by the thread afterwards is allocated on that node.
+  /// Does nothing if the CPUs of the node are unknown.
+  ///
+  /// @param[in] node The index of the node.
+  auto pin_current_thread(size_t node) const -> void;
+
+ private:
+  /// @brief CPUs of each node.
+  std::vector<std::vector<int>> nodes_;
+};
+
+}  // namespace hydrosheds
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <gdal_priv.h>
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hydrosheds {
+
+/// @brief Water mask stored with one bit per pixel.
+///
+/// Each row of the raster is stored in its own run of 64-bit words. An
+/// optional rank directory holds, for every superblock of 512 bits of a row,
+/// the number of water pixels preceding it in the row. With the directory,
+/// counting the water pixels between two columns of a row costs at most 8
+/// popcounts whatever the distance between the columns, and counting the
+/// water pixels of a box costs one difference of ranks per row.
+class PackedMask {
+ public:
+  /// @brief Number of 64-bit words per superblock of the rank directory.
+  static constexpr size_t kWordsPerSuperblock = 8;
+
+  /// @brief Constructs a mask of the given size where all pixels are land.
+  ///
+  /// @param[in] x_size The size of the raster in the x-direction.
+  /// @param[in] y_size The size of the raster in the y-direction.
+  PackedMask(size_t x_size, size_t y_size)
+      : x_size_(x_size),
+        y_size_(y_size),
+        words_per_row_((x_size + 63) / 64),
+        words_(words_per_row_ * y_size) {}
+
+  /// @brief Builds the mask by streaming the raster band row by row.
+  ///
+  /// @param[in] band The raster band holding the water mask.
+  /// @param[in] x_size The size of the raster in the x-direction.
+  /// @param[in] y_size The size of the raster in the y-direction.
+  /// @param[in] rank_index If true, the rank directory is built.
+  /// @return The packed mask of the raster.
+  static auto build(GDALRasterBand *band, size_t x_size, size_t y_size,
+                    bool rank_index) -> PackedMask;
+
+  /// @brief Packs a row of pixels, a pixel is set if its value is the one
+  /// given, by default 1 for water.
+  ///
+  /// Distinct rows can be packed concurrently.
+  ///
+  /// @param[in] y The index of the row.
+  /// @param[in] pixels The x_size values of the row.
+  /// @param[in] value The value of the pixels to set.
+  auto set_row(size_t y, const uint8_t *pixels, uint8_t value = 1) noexcept
+      -> void;
+
+  /// @brief Builds the rank directory from the packed pixels.
+  auto build_rank_index() -> void;
+
+  /// @brief Checks if the rank directory is available.
+  ///
+  /// @return true if the rank directory has been built.
+  inline auto has_rank_index() const noexcept -> bool {
+    return !superblocks_.empty();
+  }
+
+  /// @brief Gets the size of the raster in the x-direction.
+  ///
+  /// @return The size of the raster in the x-direction.
+  constexpr auto x_size() const noexcept -> size_t { return x_size_; }
+
+  /// @brief Gets the size of the raster in the y-direction.
+  ///
+  /// @return The size of the raster in the y-direction.
+  constexpr auto y_size() const noexcept -> size_t { return y_size_; }
+
+  /// @brief Checks if a pixel is water.
+  ///
+  /// @param[in] x The x-coordinate of the pixel.
+  /// @param[in] y The y-coordinate of the pixel.
+  /// @return true if the pixel is water, false otherwise.
+  inline auto test(size_t x, size_t y) const noexcept -> bool {
+    return (words_[y * words_per_row_ + x / 64] >> (x % 64)) & 1;
+  }
+
+  /// @brief Counts the water pixels of a row located before a column.
+  ///
+  /// The rank directory must have been built.
+  ///
+  /// @param[in] y The index of the row.
+  /// @param[in] x The column, between 0 and x_size.
+  /// @return The number of water pixels in [0, x) of the row.
+  inline auto rank(size_t y, size_t x) const noexcept -> size_t {
+    const auto *row = words_.data() + y * words_per_row_;
+    auto word = x / 64;
+    auto superblock = word / kWordsPerSuperblock;
+    size_t result = superblocks_[y * superblocks_per_row_ + superblock];
+    for (auto ix = superblock * kWordsPerSuperblock; ix < word; ++ix) {
+      result += static_cast<size_t>(std::popcount(row[ix]));
+    }
+    if (x % 64 != 0) {
+      result += static_cast<size_t>(
+          std::popcount(row[word] & ((uint64_t(1) << (x % 64)) - 1)));
+    }
+    return result;
+  }
+
+  /// @brief Counts the water pixels of a row between two columns.
+  ///
+  /// @param[in] y The index of the row.
+  /// @param[in] x0 The first column, included.
+  /// @param[in] x1 The last column, excluded.
+  /// @return The number of water pixels in [x0, x1) of the row.
+  inline auto count(size_t y, size_t x0, size_t x1) const noexcept -> size_t {
+    return rank(y, x1) - rank(y, x0);
+  }
+
+  /// @brief Counts the water pixels of a box.
+  ///
+  /// @param[in] x0 The first column, included.
+  /// @param[in] y0 The first row, included.
+  /// @param[in] x1 The last column, excluded.
+  /// @param[in] y1 The last row, excluded.
+  /// @return The number of water pixels in the box.
+  auto count(size_t x0, size_t y0, size_t x1,
+             size_t y1) const noexcept -> size_t;
+
+ private:
+  /// @brief Size of the raster in the x-direction.
+  size_t x_size_;
+  /// @brief Size of the raster in the y-direction.
+  size_t y_size_;
+  /// @brief Number of 64-bit words used to store a row.
+  size_t words_per_row_;
+  /// @brief Number of superblocks of the rank directory per row.
+  size_t superblocks_per_row_{};
+  /// @brief Packed pixels, stored row by row.
+  std::vector<uint64_t> words_;
+  /// @brief Number of water pixels of the row preceding each superblock.
+  std::vector<uint32_t> superblocks_{};
+};
+
+}  // namespace hydrosheds
@@ -1,18 +1,53 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
+#include <exception>
 #include <functional>
+#include <mutex>
 #include <thread>
+#include <utility>
 #include <vector>
 
 namespace hydrosheds {
 
+/// @brief Gets the handler polled by the thread calling parallel_for while
+/// the workers are running.
+///
+/// The handler is expected to throw an exception to interrupt the
+/// calculation, for example when the user presses Ctrl+C in the Python
+/// interpreter. An empty handler disables the polling.
+///
+/// @return A reference to the handler.
+inline auto interrupt_handler() -> std::function<void()> & {
+  static std::function<void()> handler;
+  return handler;
+}
+
+/// @brief Sets the handler polled by the thread calling parallel_for while
+/// the workers are running.
+///
+/// @param[in] handler The handler to install.
+inline auto set_interrupt_handler(std::function<void()> handler) -> void {
+  interrupt_handler() = std::move(handler);
+}
+
 /// @brief Parallelizes a for loop using a given number of threads.
 ///
 /// This function parallelizes a for loop using a given number of threads.
-/// The function takes a lambda function as input, which is called for each
-/// iteration of the loop. The lambda function should take two size_t
-/// arguments, which represent the start and end indices of the loop.
+/// The function takes a lambda function as input, which is called once per
+/// thread. The lambda function should take two size_t arguments, which
+/// represent the start and end indices of the loop, and a reference to an
+/// atomic boolean set when the calculation is cancelled. The lambda function
+/// should check this flag between chunks of work and return as soon as it is
+/// set.
+///
+/// The calculation is cancelled as soon as a worker throws an exception, or
+/// when the interrupt handler throws. The first exception is rethrown once
+/// all the threads have stopped.
 ///
 /// @tparam Lambda The type of the lambda function to be called for each
 /// iteration of the loop.
@@ -23,8 +58,16 @@ namespace hydrosheds {
 /// set to 0, the function will use the number of hardware threads available.
 template <typename Lambda>
 void parallel_for(const Lambda &worker, size_t size, size_t num_threads) {
-  if (num_threads == 1) {
-    worker(0, size);
+  if (size == 0) {
+    return;
+  }
+
+  const auto &handler = interrupt_handler();
+  auto cancelled = std::atomic<bool>(false);
+
+  // Without interrupt handler to poll, there is no need for a thread.
+  if (num_threads == 1 && !handler) {
+    worker(0, size, cancelled);
     return;
   }
 
@@ -33,11 +76,26 @@ void parallel_for(const Lambda &worker, size_t size, size_t num_threads) {
   }
 
   // Adjust num_threads to not exceed the size
-  num_threads = std::min(num_threads, size);
+  num_threads = std::max<size_t>(std::min(num_threads, size), 1);
 
   // List of threads responsible for parallelizing the calculation
   std::vector<std::thread> threads;
+
+  // The first exception raised. Only the thread that sets the failed flag
+  // writes it, and it is read after the threads are joined.
   std::exception_ptr exception = nullptr;
+  auto failed = std::atomic<bool>(false);
+  auto fail = [&]() {
+    if (!failed.exchange(true)) {
+      exception = std::current_exception();
+    }
+    cancelled = true;
+  };
+
+  // Number of threads still running, used to wake up the calling thread.
+  auto mutex = std::mutex();
+  auto finished = std::condition_variable();
+  auto running = num_threads;
 
   // Access index to the vectors required for calculation
   size_t start = 0;
@@ -48,16 +106,40 @@ void parallel_for(const Lambda &worker, size_t size, size_t num_threads) {
   // Launch threads
   for (size_t ix = 0; ix < num_threads; ++ix) {
     size_t end = (ix == num_threads - 1) ? size : start + shift;
-    threads.emplace_back([&worker, start, end, &exception]() {
+    threads.emplace_back([&, start, end]() {
       try {
-        worker(start, end);
+        worker(start, end, cancelled);
       } catch (...) {
-        exception = std::current_exception();
+        fail();
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--running == 0) {
+        finished.notify_one();
       }
     });
     start += shift;
   }
 
+  // Poll the interrupt handler until the threads are done.
+  if (handler) {
+    auto lock = std::unique_lock<std::mutex>(mutex);
+    while (running != 0) {
+      if (finished.wait_for(lock, std::chrono::milliseconds(50),
+                            [&] { return running == 0; })) {
+        break;
+      }
+      if (!cancelled) {
+        lock.unlock();
+        try {
+          handler();
+        } catch (...) {
+          fail();
+        }
+        lock.lock();
+      }
+    }
+  }
+
   // Join threads
   for (auto &&thread : threads) {
     if (thread.joinable()) {
@@ -65,7 +147,7 @@ void parallel_for(const Lambda &worker, size_t size, size_t num_threads) {
     }
   }
 
-  // Rethrow the last exception caught
+  // Rethrow the first exception caught
   if (exception) {
     std::rethrow_exception(exception);
   }
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <tuple>
+
+#include "hydrosheds/tile_cache.hpp"
+
+namespace hydrosheds {
+
+/// @brief Loads tiles in the background, ahead of the queries.
+///
+/// The requests are queued and served by a single low-priority thread. The
+/// number of tiles worth requesting after a miss is throttled according to
+/// the fraction of the prefetched tiles that were actually used.
+class Prefetcher {
+ public:
+  /// @brief Tile to load in the background.
+  struct Request {
+    /// @brief Index of the dataset holding the tile.
+    size_t dataset;
+    /// @brief NUMA node caching the tile.
+    size_t node;
+    /// @brief Key of the tile.
+    TileKey key;
+  };
+
+  /// @brief Maximum number of tiles requested after a miss: the neighbours
+  /// of the missing tile.
+  static constexpr size_t kMaxBudget = 8;
+
+  /// @brief Starts the background thread.
+  ///
+  /// @param[in] load The function loading a tile into the shared cache. The
+  /// exceptions it throws are ignored: prefetching is best effort.
+  explicit Prefetcher(std::function<void(const Request &)> load);
+
+  /// @brief Stops the background thread, discarding the pending requests.
+  ~Prefetcher();
+
+  Prefetcher(const Prefetcher &) = delete;
+  auto operator=(const Prefetcher &) -> Prefetcher & = delete;
+
+  /// @brief Gets the number of tiles worth requesting after a miss.
+  ///
+  /// @return Between 1 and kMaxBudget, in proportion to the recent hit ratio
+  /// of the prefetched tiles.
+  auto budget() const -> size_t;
+
+  /// @brief Queues a tile to load.
+  ///
+  /// A tile already queued or being loaded is not queued again, nor counted
+  /// as issued.
+  ///
+  /// @param[in] request The tile to load.
+  /// @return False if the queue is full and the request was dropped.
+  auto enqueue(const Request &request) -> bool;
+
+  /// @brief Records the use of a prefetched tile.
+  auto record_hit() -> void;
+
+  /// @brief Gets the number of tiles loaded in the background.
+  /// @return The number of tiles queued since the start.
+  auto issued() const -> uint64_t;
+
+  /// @brief Gets the number of prefetched tiles used by a query.
+  /// @return The number of hits since the start.
+  auto hits() const -> uint64_t;
+
+ private:
+  /// @brief Maximum number of pending requests.
+  static constexpr size_t kMaxQueue = 1024;
+  /// @brief Number of requests issued before the throttling starts.
+  static constexpr uint64_t kWarmup = 64;
+  /// @brief Number of requests after which the recent counters are halved.
+  static constexpr uint64_t kWindow = 1024;
+
+  /// @brief Function loading a tile.
+  std::function<void(const Request &)> load_;
+  /// @brief Mutex protecting the queue and the counters.
+  mutable std::mutex mutex_{};
+  /// @brief Signals a new request or the end of the thread.
+  std::condition_variable wake_{};
+  /// @brief Pending requests.
+  std::deque<Request> queue_{};
+  /// @brief Dataset, node and key of the requests queued or being served.
+  std::set<std::tuple<size_t, size_t, TileKey>> pending_{};
+  /// @brief True when the thread must stop.
+  bool stop_{false};
+  /// @brief Number of requests issued since the start.
+  uint64_t issued_{0};
+  /// @brief Number of hits since the start.
+  uint64_t hits_{0};
+  /// @brief Number of requests issued recently.
+  uint64_t recent_issued_{0};
+  /// @brief Number of hits recently.
+  uint64_t recent_hits_{0};
+  /// @brief Background thread serving the requests.
+  std::thread thread_;
+
+  /// @brief Serves the requests until the object is destroyed.
+  auto run() -> void;
+};
+
+}  // namespace hydrosheds
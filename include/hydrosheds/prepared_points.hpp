@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "hydrosheds/tile_cache.hpp"
+
+namespace hydrosheds {
+
+/// @brief Pixel addresses of a fixed set of points in the datasets.
+///
+/// The addresses are computed once by Dataset::prepare: the coordinate
+/// transformations, the bounding box tests and the pixel arithmetic are not
+/// repeated when the same points are queried again. The addresses are sorted
+/// by dataset, then by tile, so that evaluating them is a gather over the
+/// pixels of each tile in turn.
+///
+/// The addresses stay valid for any Dataset whose rasters have the same
+/// grids as the ones used to prepare them, for example another version of
+/// the masks.
+class PreparedPoints {
+ public:
+  /// @brief Grid of a raster the addresses were computed for.
+  struct Grid {
+    /// @brief Geotransform parameters.
+    std::array<double, 6> geotransform;
+    /// @brief Size of the raster in the x-direction.
+    size_t x_size;
+    /// @brief Size of the raster in the y-direction.
+    size_t y_size;
+
+    auto operator==(const Grid &other) const noexcept -> bool = default;
+  };
+
+  /// @brief Address of a point in a dataset.
+  struct Address {
+    /// @brief Index of the dataset.
+    uint32_t dataset;
+    /// @brief Tile holding the point.
+    TileKey tile;
+    /// @brief Offset of the pixel holding the point in the tile.
+    uint32_t offset;
+    /// @brief Index of the point.
+    size_t point;
+  };
+
+  /// @brief Points of a dataset falling in the same tile.
+  struct TileGroup {
+    /// @brief The tile.
+    TileKey tile;
+    /// @brief Index of the first address of the group.
+    size_t begin;
+    /// @brief Index past the last address of the group.
+    size_t end;
+  };
+
+  /// @brief Sorts and groups the addresses of a set of points.
+  ///
+  /// @param[in] size The number of points.
+  /// @param[in] tile_size The size of the tiles.
+  /// @param[in] grids The grid of each dataset.
+  /// @param[in] addresses The address of the points in each dataset
+  /// covering them, in any order.
+  PreparedPoints(size_t size, size_t tile_size, std::vector<Grid> grids,
+                 std::vector<Address> addresses);
+
+  /// @brief Gets the number of points.
+  /// @return The number of points prepared.
+  inline auto size() const noexcept -> size_t { return size_; }
+
+  /// @brief Gets the size of the tiles.
+  /// @return The size of the tiles the offsets refer to.
+  inline auto tile_size() const noexcept -> size_t { return tile_size_; }
+
+  /// @brief Gets the grids of the datasets.
+  /// @return The grid of each dataset, in the order of the datasets.
+  inline auto grids() const noexcept -> const std::vector<Grid> & {
+    return grids_;
+  }
+
+  /// @brief Gets the tiles of a dataset holding points.
+  /// @param[in] dataset The index of the dataset.
+  /// @return The groups of points of the dataset, sorted by row of tiles.
+  inline auto groups(size_t dataset) const noexcept
+      -> std::span<const TileGroup> {
+    return {groups_.data() + first_group_[dataset],
+            groups_.data() + first_group_[dataset + 1]};
+  }
+
+  /// @brief Gets the index of the points of the addresses.
+  /// @return The index of the point of each address.
+  inline auto points() const noexcept -> const std::vector<size_t> & {
+    return points_;
+  }
+
+  /// @brief Gets the offsets of the pixels of the addresses.
+  /// @return The offset of the pixel of each address in its tile.
+  inline auto offsets() const noexcept -> const std::vector<uint32_t> & {
+    return offsets_;
+  }
+
+  /// @brief Gets the number of addresses.
+  /// @return The number of pairs of point and dataset covering it.
+  inline auto addresses() const noexcept -> size_t { return points_.size(); }
+
+ private:
+  /// @brief Number of points.
+  size_t size_;
+  /// @brief Size of the tiles.
+  size_t tile_size_;
+  /// @brief Grid of each dataset.
+  std::vector<Grid> grids_;
+  /// @brief Index of the first group of each dataset, followed by the
+  /// number of groups.
+  std::vector<size_t> first_group_;
+  /// @brief Groups of addresses sharing a tile.
+  std::vector<TileGroup> groups_;
+  /// @brief Index of the point of each address.
+  std::vector<size_t> points_;
+  /// @brief Offset of the pixel of each address in its tile.
+  std::vector<uint32_t> offsets_;
+};
+
+}  // namespace hydrosheds
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <ogr_spatialref.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace hydrosheds {
+
+/// @brief Holds a pointer to an OGRCoordinateTransformation object and a custom
+/// deleter.
+using OGRCoordinateTransformationSmartPtr =
+    std::unique_ptr<OGRCoordinateTransformation,
+                    void (*)(OGRCoordinateTransformation *)>;
+
+/// @brief Creates a coordinate transformation from an EPSG code to the
+/// projection of a raster.
+/// @param[in] wkt The projection of the raster, in WKT.
+/// @param[in] espg_code The EPSG code of the input coordinates.
+/// @return The transformation, taking and returning the coordinates in the
+/// traditional GIS order.
+/// @throw std::runtime_error if the EPSG code is invalid.
+inline auto create_coordinate_transformation(const char *wkt,
+                                             const int espg_code)
+    -> OGRCoordinateTransformationSmartPtr {
+  OGRSpatialReference srs;
+  srs.importFromWkt(&wkt);
+  OGRSpatialReference srs_latlon;
+  if (srs_latlon.importFromEPSG(espg_code) != OGRERR_NONE) {
+    throw std::runtime_error("Invalid EPSG code: " + std::to_string(espg_code));
+  }
+  // The coordinates are always given, and the geotransforms always expressed,
+  // as (x, y) or (longitude, latitude), whatever the axis order declared by
+  // the authority of either coordinate system.
+  srs.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+  srs_latlon.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+  return OGRCoordinateTransformationSmartPtr(
+      OGRCreateCoordinateTransformation(&srs_latlon, &srs),
+      [](OGRCoordinateTransformation *ct) {
+        OCTDestroyCoordinateTransformation(ct);
+      });
+}
+
+/// @brief Creates a coordinate transformation between the projections of two
+/// rasters.
+/// @param[in] source_wkt The projection of the source raster, in WKT.
+/// @param[in] target_wkt The projection of the target raster, in WKT.
+/// @return The transformation, taking and returning the coordinates in the
+/// traditional GIS order.
+inline auto create_coordinate_transformation(const char *source_wkt,
+                                             const char *target_wkt)
+    -> OGRCoordinateTransformationSmartPtr {
+  OGRSpatialReference source;
+  source.importFromWkt(&source_wkt);
+  OGRSpatialReference target;
+  target.importFromWkt(&target_wkt);
+  source.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+  target.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+  return OGRCoordinateTransformationSmartPtr(
+      OGRCreateCoordinateTransformation(&source, &target),
+      [](OGRCoordinateTransformation *ct) {
+        OCTDestroyCoordinateTransformation(ct);
+      });
+}
+
+/// @brief Checks if a coordinate system is geographic.
+/// @param[in] wkt The coordinate system, in WKT.
+/// @return True if the coordinate system is geographic.
+inline auto is_geographic(const char *wkt) -> bool {
+  OGRSpatialReference srs;
+  return srs.importFromWkt(&wkt) == OGRERR_NONE && srs.IsGeographic();
+}
+
+/// @brief Checks if an EPSG code designates a geographic coordinate system.
+/// @param[in] espg_code The EPSG code.
+/// @return True if the coordinate system is geographic.
+inline auto is_geographic(const int espg_code) -> bool {
+  OGRSpatialReference srs;
+  return srs.importFromEPSG(espg_code) == OGRERR_NONE && srs.IsGeographic();
+}
+
+/// @brief Checks if an EPSG code designates the coordinate system of a
+/// raster.
+/// @param[in] wkt The coordinate system of the raster, in WKT.
+/// @param[in] espg_code The EPSG code.
+/// @return True if both designate the same coordinate system.
+inline auto same_coordinate_system(const char *wkt, const int espg_code)
+    -> bool {
+  OGRSpatialReference srs;
+  srs.importFromWkt(&wkt);
+  OGRSpatialReference srs_input;
+  return srs_input.importFromEPSG(espg_code) == OGRERR_NONE &&
+         srs.IsSame(&srs_input);
+}
+
+/// @brief Checks if two rasters share a coordinate system.
+/// @param[in] lhs The coordinate system of the first raster, in WKT.
+/// @param[in] rhs The coordinate system of the second raster, in WKT.
+/// @return True if both designate the same coordinate system.
+inline auto same_coordinate_system(const char *lhs, const char *rhs) -> bool {
+  OGRSpatialReference lhs_srs;
+  OGRSpatialReference rhs_srs;
+  return lhs_srs.importFromWkt(&lhs) == OGRERR_NONE &&
+         rhs_srs.importFromWkt(&rhs) == OGRERR_NONE &&
+         lhs_srs.IsSame(&rhs_srs);
+}
+
+}  // namespace hydrosheds
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <gdal_priv.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hydrosheds {
+
+/// @brief Spreads the bits of a 32-bit integer so that they occupy the even
+/// bits of a 64-bit integer.
+///
+/// @param[in] value The value to spread.
+/// @return The spread value.
+constexpr auto spread_bits(uint64_t value) noexcept -> uint64_t {
+  value &= 0xFFFFFFFFULL;
+  value = (value | (value << 16)) & 0x0000FFFF0000FFFFULL;
+  value = (value | (value << 8)) & 0x00FF00FF00FF00FFULL;
+  value = (value | (value << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  value = (value | (value << 2)) & 0x3333333333333333ULL;
+  value = (value | (value << 1)) & 0x5555555555555555ULL;
+  return value;
+}
+
+/// @brief Gathers the even bits of a 64-bit integer into a 32-bit integer.
+///
+/// @param[in] value The value to compact.
+/// @return The compacted value.
+constexpr auto compact_bits(uint64_t value) noexcept -> uint32_t {
+  value &= 0x5555555555555555ULL;
+  value = (value | (value >> 1)) & 0x3333333333333333ULL;
+  value = (value | (value >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+  value = (value | (value >> 4)) & 0x00FF00FF00FF00FFULL;
+  value = (value | (value >> 8)) & 0x0000FFFF0000FFFFULL;
+  value = (value | (value >> 16)) & 0x00000000FFFFFFFFULL;
+  return static_cast<uint32_t>(value);
+}
+
+/// @brief Computes the Morton key (Z-order) of a pixel.
+///
+/// @param[in] x The x-coordinate of the pixel.
+/// @param[in] y The y-coordinate of the pixel.
+/// @return The Morton key of the pixel.
+constexpr auto morton_encode(uint32_t x, uint32_t y) noexcept -> uint64_t {
+  return spread_bits(x) | (spread_bits(y) << 1);
+}
+
+/// @brief Linear (pointerless) region quadtree encoding a water mask.
+///
+/// The water leaves of the quadtree are stored by their Morton key. Leaves
+/// that are contiguous along the Z-order curve are merged, so the tree is
+/// represented by a sorted list of disjoint ranges of Morton keys covering
+/// the water pixels. A lookup is a binary search of the Morton key of the
+/// pixel. The whole structure is kept in memory and serialized to a single
+/// file.
+class LinearQuadtree {
+ public:
+  /// @brief Builds the quadtree of a water mask.
+  ///
+  /// @param[in] path The path to the raster holding the water mask.
+  /// @return The quadtree encoding the water pixels of the raster.
+  static auto build(const std::string &path) -> LinearQuadtree;
+
+  /// @brief Loads a quadtree previously written by save.
+  ///
+  /// @param[in] path The path to the file to read.
+  /// @return The quadtree stored in the file.
+  static auto load(const std::string &path) -> LinearQuadtree;
+
+  /// @brief Writes the quadtree to a file.
+  ///
+  /// @param[in] path The path to the file to write.
+  auto save(const std::string &path) const -> void;
+
+  /// @brief Checks if a pixel is water.
+  ///
+  /// @param[in] pixel_x The x-coordinate of the pixel.
+  /// @param[in] pixel_y The y-coordinate of the pixel.
+  /// @return true if the pixel is water, false otherwise.
+  inline auto is_water(size_t pixel_x, size_t pixel_y) const noexcept
+      -> bool {
+    if (pixel_x >= x_size_ || pixel_y >= y_size_) {
+      return false;
+    }
+    auto key = morton_encode(static_cast<uint32_t>(pixel_x),
+                             static_cast<uint32_t>(pixel_y));
+    auto it = std::upper_bound(begins_.begin(), begins_.end(), key);
+    if (it == begins_.begin()) {
+      return false;
+    }
+    return key < ends_[std::distance(begins_.begin(), it) - 1];
+  }
+
+  /// @brief Gets the geotransform parameters of the encoded raster.
+  ///
+  /// @return The geotransform parameters.
+  constexpr auto geotransform() const noexcept
+      -> const std::array<double, 6> & {
+    return geotransform_;
+  }
+
+  /// @brief Gets the projection of the encoded raster.
+  ///
+  /// @return The WKT representation of the projection.
+  constexpr auto projection() const noexcept -> const std::string & {
+    return projection_;
+  }
+
+  /// @brief Gets the size of the encoded raster in the x-direction.
+  ///
+  /// @return The size of the raster in the x-direction.
+  constexpr auto x_size() const noexcept -> size_t { return x_size_; }
+
+  /// @brief Gets the size of the encoded raster in the y-direction.
+  ///
+  /// @return The size of the raster in the y-direction.
+  constexpr auto y_size() const noexcept -> size_t { return y_size_; }
+
+  /// @brief Gets the number of ranges of Morton keys stored.
+  ///
+  /// @return The number of ranges.
+  inline auto size() const noexcept -> size_t { return begins_.size(); }
+
+ private:
+  /// @brief Geotransform parameters of the encoded raster.
+  std::array<double, 6> geotransform_{};
+  /// @brief WKT representation of the projection of the encoded raster.
+  std::string projection_{};
+  /// @brief Size of the encoded raster in the x-direction.
+  size_t x_size_{};
+  /// @brief Size of the encoded raster in the y-direction.
+  size_t y_size_{};
+  /// @brief First Morton key of each range of water pixels.
+  std::vector<uint64_t> begins_{};
+  /// @brief Morton key following the last pixel of each range.
+  std::vector<uint64_t> ends_{};
+
+  /// @brief Appends the water ranges of a square block of the raster.
+  ///
+  /// @param[in] block The pixels of the block, stored row by row.
+  /// @param[in] block_size The size of the block along each axis.
+  /// @param[in] x_offset The x-coordinate of the first pixel of the block.
+  /// @param[in] y_offset The y-coordinate of the first pixel of the block.
+  auto append_block(const std::vector<uint8_t> &block, size_t block_size,
+                    size_t x_offset, size_t y_offset) -> void;
+};
+
+}  // namespace hydrosheds
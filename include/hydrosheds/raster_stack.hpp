@@ -0,0 +1,170 @@
+#pragma once
+
+#include <gdal_priv.h>
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "hydrosheds/dataset.hpp"
+#include "hydrosheds/projection.hpp"
+#include "hydrosheds/tile_cache.hpp"
+
+namespace hydrosheds {
+
+/// @brief Samples several rasters at the same points in a single pass.
+///
+/// The rasters, for example a water mask, a flow accumulation and a digital
+/// elevation model, may have different data types, grids and coordinate
+/// systems. The points are transformed once per distinct coordinate system,
+/// their pixel is located once per distinct grid, and the rasters sharing a
+/// grid fetch the tile holding a point together. The tiles are kept in their
+/// native data type, in a cache shared by the threads and kept between the
+/// calls.
+class RasterStack {
+ public:
+  /// @brief Opens the rasters to sample.
+  ///
+  /// @param[in] paths The paths to the rasters. The first band of each
+  /// raster is sampled.
+  /// @param[in] espg_code The EPSG code of the coordinates of the points.
+  /// Defaults to 4326.
+  /// @param[in] tile_size The size of the tiles used to cache the rasters.
+  /// Defaults to 256.
+  /// @param[in] max_cache_size The maximum number of tiles held in memory by
+  /// the caches shared by the threads and kept between the calls, for all the
+  /// rasters, as for a Dataset. The budget is split evenly between the
+  /// rasters. Defaults to 4096.
+  /// @throw std::runtime_error if a raster cannot be opened.
+  RasterStack(const std::vector<std::string> &paths, int espg_code = 4326,
+              size_t tile_size = 256, size_t max_cache_size = 4096);
+
+  /// @brief Gets the number of rasters.
+  /// @return The number of rasters sampled.
+  inline auto size() const noexcept -> size_t { return rasters_.size(); }
+
+  /// @brief Samples the rasters at the given points.
+  ///
+  /// @param[in] lon The longitude of the points.
+  /// @param[in] lat The latitude of the points.
+  /// @param[in] num_threads The number of threads to use for parallelization.
+  /// @return The values of each raster at the points, in the order of the
+  /// paths. The points outside a raster, on a nodata pixel, or that cannot
+  /// be transformed to its coordinate system are set to NaN.
+  auto sample(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+              size_t num_threads = 0) const -> std::vector<VectorFloat64>;
+
+ private:
+  /// @brief Raster sampled.
+  struct Raster {
+    /// @brief GDAL dataset pointer.
+    GDALDatasetSmartPtr dataset;
+    /// @brief Mutex to protect the dataset from concurrent access.
+    std::unique_ptr<std::mutex> mutex;
+    /// @brief Data type of the tiles.
+    GDALDataType type;
+    /// @brief Size of a pixel of the tiles, in bytes.
+    size_t pixel_bytes;
+    /// @brief True if the raster has a nodata value.
+    bool has_nodata;
+    /// @brief Nodata value of the raster.
+    double nodata;
+    /// @brief Index of the grid of the raster.
+    size_t grid;
+    /// @brief Tiles shared by the threads.
+    std::unique_ptr<SharedTileCache> cache;
+  };
+
+  /// @brief Grid shared by one or more rasters.
+  struct Grid {
+    /// @brief Geotransform parameters.
+    std::array<double, 6> geotransform;
+    /// @brief Size of the grid in the x-direction.
+    size_t x_size;
+    /// @brief Size of the grid in the y-direction.
+    size_t y_size;
+    /// @brief True if the columns are wrapped around the globe.
+    bool wrap;
+    /// @brief Index of the rasters on the grid.
+    std::vector<size_t> rasters;
+  };
+
+  /// @brief Coordinate system shared by one or more grids.
+  struct Projection {
+    /// @brief Coordinate system, in WKT.
+    std::string wkt;
+    /// @brief Transformation from the coordinates of the points, cloned by
+    /// each thread.
+    OGRCoordinateTransformationSmartPtr transform;
+    /// @brief Index of the grids in the coordinate system.
+    std::vector<size_t> grids;
+  };
+
+  /// @brief State of a thread sampling the rasters.
+  struct Context {
+    /// @brief Transformation of each coordinate system.
+    std::vector<OGRCoordinateTransformationSmartPtr> transforms;
+    /// @brief Tiles of each raster used by the thread.
+    std::vector<TileCache> caches;
+    /// @brief Tiles of the rasters of the current grid holding the current
+    /// point.
+    std::vector<Tile> tiles;
+    /// @brief Coordinates of the points of the chunk, transformed.
+    std::vector<double> x;
+    /// @brief Coordinates of the points of the chunk, transformed.
+    std::vector<double> y;
+    /// @brief Status of the transformation of the points.
+    std::vector<int> success;
+  };
+
+  /// @brief Number of points processed at once by a worker.
+  static constexpr size_t kChunkSize = 4096;
+
+  /// @brief Size of the tiles.
+  size_t tile_size_;
+  /// @brief Maximum number of tiles of a raster held by the cache of a
+  /// thread.
+  size_t local_cache_size_;
+  /// @brief Rasters sampled.
+  std::vector<Raster> rasters_;
+  /// @brief Distinct grids of the rasters.
+  std::vector<Grid> grids_;
+  /// @brief Distinct coordinate systems of the grids.
+  std::vector<Projection> projections_;
+
+  /// @brief Creates the state of a thread.
+  /// @return The context.
+  auto create_context() const -> Context;
+
+  /// @brief Gets a tile of a raster, reading it if no cache holds it.
+  /// @param[in] index The index of the raster.
+  /// @param[in] tile_key The key of the tile.
+  /// @param[in,out] context The state of the thread.
+  /// @return The tile.
+  auto fetch_tile(size_t index, const TileKey &tile_key,
+                  Context &context) const -> Tile;
+
+  /// @brief Reads a tile of a raster.
+  /// @param[in] index The index of the raster.
+  /// @param[in] tile_key The key of the tile.
+  /// @return The tile, in the data type of the raster.
+  auto read_tile(size_t index, const TileKey &tile_key) const -> Tile;
+
+  /// @brief Samples the rasters of a coordinate system at a chunk of points.
+  /// @param[in] projection The coordinate system.
+  /// @param[in] lon The longitude of the points.
+  /// @param[in] lat The latitude of the points.
+  /// @param[in] first The index of the first point of the chunk.
+  /// @param[in] last The index past the last point of the chunk.
+  /// @param[in,out] context The state of the thread.
+  /// @param[in,out] result The values of each raster.
+  auto sample_chunk(size_t projection, ConstRefVectorFloat64 lon,
+                    ConstRefVectorFloat64 lat, size_t first, size_t last,
+                    Context &context,
+                    std::vector<VectorFloat64> &result) const -> void;
+};
+
+}  // namespace hydrosheds
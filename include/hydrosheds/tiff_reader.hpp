@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace hydrosheds {
+
+/// @brief Reads the tiles of a tiled GeoTIFF mask without GDAL.
+///
+/// The reader handles the common layout of the HydroSHEDS masks: tiled,
+/// 8-bit, single band, uncompressed, DEFLATE or LZW compressed, with or
+/// without horizontal differencing. The offsets and sizes of the tiles are
+/// parsed once when the file is opened. A tile is then read with a single
+/// positioned read and decompressed straight into the buffer of the caller,
+/// without going through the block cache of GDAL. The reads can be issued
+/// concurrently.
+class TiffTileReader {
+ public:
+  /// @brief Tile requested from read_batch.
+  struct TileRead {
+    /// @brief The index of the tile in the x-direction.
+    size_t tile_x;
+    /// @brief The index of the tile in the y-direction.
+    size_t tile_y;
+    /// @brief The buffer receiving the pixels.
+    char *buffer;
+  };
+
+  /// @brief Range of the file read for a tile of a batch.
+  struct ReadRequest {
+    /// @brief Position of the tile in the batch.
+    size_t id;
+    /// @brief Offset of the range in the file.
+    uint64_t offset;
+    /// @brief Buffer receiving the bytes read.
+    void *target;
+    /// @brief Size of the range.
+    size_t size;
+  };
+
+  /// @brief Opens a file if its layout is supported.
+  ///
+  /// @param[in] path The path to the GeoTIFF file.
+  /// @param[in] tile_size The size of the tiles requested by the caller: the
+  /// tiles of the file must have the same size.
+  /// @return The reader, or a null pointer if the file must be read by GDAL.
+  static auto open(const std::string &path, size_t tile_size)
+      -> std::unique_ptr<TiffTileReader>;
+
+  /// @brief Closes the file.
+  ~TiffTileReader();
+
+  TiffTileReader(const TiffTileReader &) = delete;
+  auto operator=(const TiffTileReader &) -> TiffTileReader & = delete;
+
+  /// @brief Gets the size of the image in the x-direction.
+  /// @return The size of the image in the x-direction.
+  inline auto x_size() const noexcept -> size_t { return x_size_; }
+
+  /// @brief Gets the size of the image in the y-direction.
+  /// @return The size of the image in the y-direction.
+  inline auto y_size() const noexcept -> size_t { return y_size_; }
+
+  /// @brief Reads a tile.
+  ///
+  /// The tile is written row by row, tile_size bytes per row. The tiles on
+  /// the right and bottom edges are padded as stored in the file.
+  ///
+  /// @param[in] tile_x The index of the tile in the x-direction.
+  /// @param[in] tile_y The index of the tile in the y-direction.
+  /// @param[in] fill The value of the pixels of a tile missing in the file.
+  /// @param[out] buffer The buffer receiving the pixels, holding at least
+  /// tile_size * tile_size bytes.
+  auto read(size_t tile_x, size_t tile_y, uint8_t fill, char *buffer) const
+      -> void;
+
+  /// @brief Reads several tiles at once.
+  ///
+  /// The reads are submitted together through io_uring when the library is
+  /// built with it and the kernel supports it. Otherwise they are issued by a
+  /// few threads shared by all the readers, keeping several reads in flight.
+  /// Each tile is decoded by the calling thread as soon as its read
+  /// completes.
+  ///
+  /// @param[in] reads The tiles to read, with their buffers.
+  /// @param[in] fill The value of the pixels of a tile missing in the file.
+  auto read_batch(const std::vector<TileRead> &reads, uint8_t fill) const
+      -> void;
+
+ private:
+  /// @brief Compression of the tiles.
+  enum class Compression : uint8_t {
+    /// @brief The tiles are stored uncompressed.
+    kNone = 0,
+    /// @brief The tiles are DEFLATE compressed.
+    kDeflate = 1,
+    /// @brief The tiles are LZW compressed.
+    kLzw = 2,
+  };
+
+  /// @brief File descriptor of the file.
+  int fd_;
+  /// @brief Size of the image in the x-direction.
+  size_t x_size_{};
+  /// @brief Size of the image in the y-direction.
+  size_t y_size_{};
+  /// @brief Size of the tiles.
+  size_t tile_size_{};
+  /// @brief Number of tiles in the x-direction.
+  size_t tiles_x_{};
+  /// @brief Compression of the tiles.
+  Compression compression_{};
+  /// @brief True if the pixels are stored with horizontal differencing.
+  bool predictor_{};
+  /// @brief Offset of each tile in the file.
+  std::vector<uint64_t> offsets_{};
+  /// @brief Size of each tile in the file.
+  std::vector<uint64_t> byte_counts_{};
+
+  /// @brief io_uring queues of the reader, kept between the batches.
+  ///
+  /// A batch takes an idle queue, or creates one if all are in use, and
+  /// gives it back when it is done: a queue is created per concurrent batch
+  /// over the lifetime of the reader, not per query thread.
+  struct Rings;
+  /// @brief The io_uring queues of the reader.
+  std::unique_ptr<Rings> rings_;
+
+  /// @brief Gets the index of a tile in the offsets and sizes of the tiles.
+  /// @param[in] tile_x The index of the tile in the x-direction.
+  /// @param[in] tile_y The index of the tile in the y-direction.
+  /// @return The index of the tile.
+  auto tile_index(size_t tile_x, size_t tile_y) const -> size_t;
+
+  /// @brief Decodes a tile read from the file.
+  /// @param[in] payload The compressed tile, unused if the file is not
+  /// compressed.
+  /// @param[in,out] buffer The buffer receiving the pixels, holding the
+  /// pixels read if the file is not compressed.
+  auto decode(const std::vector<uint8_t> &payload, char *buffer) const
+      -> void;
+
+  /// @brief Wraps a file descriptor.
+  /// @param[in] fd The file descriptor.
+  explicit TiffTileReader(int fd);
+};
+
+}  // namespace hydrosheds
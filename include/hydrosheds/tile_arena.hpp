@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace hydrosheds {
+
+/// @brief Allocator of fixed-size tile buffers.
+///
+/// The buffers are carved out of 2 MiB slabs, backed by huge pages when the
+/// system provides them, and are recycled when the last reference to a tile
+/// is released. Once the caches are full, loading a tile reuses the slot of
+/// an evicted one instead of calling the system allocator.
+class TileArena {
+ public:
+  /// @brief Size of the slabs, and of the huge pages backing them.
+  static constexpr size_t kSlabSize = size_t(2) << 20U;
+
+  /// @brief Constructs an arena handing out buffers of a given size.
+  /// @param[in] slot_size The size of the buffers, in bytes.
+  explicit TileArena(size_t slot_size);
+
+  /// @brief Allocates a buffer.
+  ///
+  /// The content of the buffer is undefined. The buffer stays valid as long
+  /// as a copy of the returned pointer exists, even after the arena is
+  /// destroyed.
+  ///
+  /// @return The buffer.
+  auto allocate() -> std::shared_ptr<char[]>;
+
+  /// @brief Gets the size of the buffers.
+  /// @return The size of the buffers, in bytes.
+  inline auto slot_size() const noexcept -> size_t { return slot_size_; }
+
+ private:
+  /// @brief Memory of the arena, shared with the buffers handed out.
+  class Pool {
+   public:
+    /// @brief Constructs a pool of slots of a given size.
+    /// @param[in] slot_size The size of the slots, in bytes.
+    explicit Pool(size_t slot_size);
+
+    /// @brief Releases the slabs.
+    ~Pool();
+
+    Pool(const Pool &) = delete;
+    auto operator=(const Pool &) -> Pool & = delete;
+
+    /// @brief Takes a free slot, mapping a new slab if none is left.
+    /// @return The address of the slot.
+    auto acquire() -> char *;
+
+    /// @brief Gives a slot back to the pool.
+    /// @param[in] slot The address of the slot.
+    auto release(char *slot) -> void;
+
+   private:
+    /// @brief Size of the slots, rounded up to a cache line.
+    size_t slot_size_;
+    /// @brief Size of the slabs, a multiple of kSlabSize.
+    size_t slab_size_;
+    /// @brief Mutex protecting the free list and the slabs.
+    std::mutex mutex_{};
+    /// @brief Slots available for allocation.
+    std::vector<char *> free_{};
+    /// @brief Slabs mapped by the pool.
+    std::vector<char *> slabs_{};
+  };
+
+  /// @brief Size of the buffers requested.
+  size_t slot_size_;
+  /// @brief Memory of the arena.
+  std::shared_ptr<Pool> pool_;
+};
+
+}  // namespace hydrosheds
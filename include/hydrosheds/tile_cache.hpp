@@ -2,15 +2,22 @@
 
 #include <cstddef>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <tuple>
 #include <unordered_map>
-#include <vector>
+#include <unordered_set>
+#include <utility>
 
 namespace hydrosheds {
 
 /// @brief Represents a key for a tile in the cache.
 using TileKey = std::tuple<int, int>;
 
+/// @brief Represents the pixels of a tile, shared between the caches holding
+/// it.
+using Tile = std::shared_ptr<const char[]>;
+
 }  // namespace hydrosheds
 
 namespace std {
@@ -31,13 +38,17 @@ struct hash<hydrosheds::TileKey> {
 
 namespace hydrosheds {
 
-/// @brief A simple tile cache implementation.
+/// @brief A simple LRU tile cache implementation.
 class TileCache {
  public:
   /// @brief Constructs a TileCache object with a given maximum number of tiles.
   /// @param[in] max_tiles The maximum number of tiles that the cache can hold.
   explicit TileCache(size_t max_tiles) : max_tiles_(max_tiles) {}
 
+  /// @brief Gets the maximum number of tiles that the cache can hold.
+  /// @return The maximum number of tiles.
+  inline auto max_tiles() const noexcept -> size_t { return max_tiles_; }
+
   /// @brief Checks if a tile is in the cache.
   /// @param[in] key The key of the tile to check.
   /// @return true if the tile is in the cache, false otherwise.
@@ -48,25 +59,109 @@ class TileCache {
   /// @brief Adds a tile to the cache.
   /// @param[in] key The key of the tile to add.
   /// @param[in] tile_data The data of the tile to add.
-  auto add_tile_to_cache(const TileKey &key,
-                         std::vector<char> &&tile_data) -> void;
+  auto add_tile_to_cache(const TileKey &key, Tile tile_data) -> void;
 
   /// @brief Gets a tile from the cache.
   /// @param[in] key The key of the tile to get.
   /// @return A reference to the tile data.
-  inline auto get_tile_from_cache(const TileKey &key) -> std::vector<char> & {
-    access_order_.remove(key);
-    access_order_.push_front(key);
-    return tile_map_[key];
+  inline auto get_tile_from_cache(const TileKey &key) -> const Tile & {
+    auto &entry = tile_map_.find(key)->second;
+    access_order_.splice(access_order_.begin(), access_order_, entry.second);
+    return entry.first;
+  }
+
+  /// @brief Gets a tile from the cache if it is present.
+  /// @param[in] key The key of the tile to get.
+  /// @return The tile data, or a null pointer if the tile is not cached.
+  inline auto find_tile(const TileKey &key) -> Tile {
+    auto it = tile_map_.find(key);
+    if (it == tile_map_.end()) {
+      return nullptr;
+    }
+    access_order_.splice(access_order_.begin(), access_order_,
+                         it->second.second);
+    return it->second.first;
   }
 
  private:
   /// @brief Maximum number of tiles that the cache can hold.
   size_t max_tiles_;
-  /// @brief Map of tiles in the cache.
-  std::unordered_map<TileKey, std::vector<char>> tile_map_{};
+  /// @brief Map of tiles in the cache, with their position in the access
+  /// order list.
+  std::unordered_map<TileKey, std::pair<Tile, std::list<TileKey>::iterator>>
+      tile_map_{};
   /// @brief List of tiles in the cache in access order.
   std::list<TileKey> access_order_{};
 };
 
+/// @brief A tile cache shared between threads.
+///
+/// The tiles are shared pointers: a tile evicted from the shared cache stays
+/// valid for the threads still holding it in their own cache.
+class SharedTileCache {
+ public:
+  /// @brief Constructs a SharedTileCache object with a given maximum number of
+  /// tiles.
+  /// @param[in] max_tiles The maximum number of tiles that the cache can hold.
+  explicit SharedTileCache(size_t max_tiles) : cache_(max_tiles) {}
+
+  /// @brief Gets a tile from the cache if it is present.
+  /// @param[in] key The key of the tile to get.
+  /// @param[out] prefetched Set to true if the tile was prefetched and is
+  /// used for the first time.
+  /// @return The tile data, or a null pointer if the tile is not cached.
+  inline auto find_tile(const TileKey &key, bool *prefetched = nullptr)
+      -> Tile {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto tile = cache_.find_tile(key);
+    if (prefetched != nullptr) {
+      *prefetched = tile && prefetched_.erase(key) != 0;
+    }
+    return tile;
+  }
+
+  /// @brief Checks if a tile is in the cache.
+  /// @param[in] key The key of the tile to check.
+  /// @return true if the tile is in the cache, false otherwise.
+  inline auto is_tile_in_cache(const TileKey &key) -> bool {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cache_.is_tile_in_cache(key);
+  }
+
+  /// @brief Adds a tile loaded ahead of the queries to the cache.
+  /// @param[in] key The key of the tile to add.
+  /// @param[in] tile_data The data of the tile to add.
+  inline auto add_prefetched_tile(const TileKey &key, Tile tile_data)
+      -> void {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!cache_.is_tile_in_cache(key)) {
+      cache_.add_tile_to_cache(key, std::move(tile_data));
+      // The keys of the tiles evicted before being used are not tracked:
+      // forget them all once there are more keys than tiles.
+      if (prefetched_.size() >= cache_.max_tiles()) {
+        prefetched_.clear();
+      }
+      prefetched_.insert(key);
+    }
+  }
+
+  /// @brief Adds a tile to the cache.
+  /// @param[in] key The key of the tile to add.
+  /// @param[in] tile_data The data of the tile to add.
+  inline auto add_tile_to_cache(const TileKey &key, Tile tile_data) -> void {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!cache_.is_tile_in_cache(key)) {
+      cache_.add_tile_to_cache(key, std::move(tile_data));
+    }
+  }
+
+ private:
+  /// @brief Mutex protecting the cache.
+  std::mutex mutex_{};
+  /// @brief The cache holding the tiles.
+  TileCache cache_;
+  /// @brief Keys of the prefetched tiles not used yet.
+  std::unordered_set<TileKey> prefetched_{};
+};
+
 }  // namespace hydrosheds
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace hydrosheds {
+
+/// @brief Progress of the warm-up of the tile caches.
+///
+/// The object is shared between the caller and the threads loading the tiles.
+/// All the methods are thread-safe.
+class WarmProgress {
+ public:
+  /// @brief Constructs the progress of a warm-up.
+  /// @param[in] total_tiles The number of tiles to load.
+  /// @param[in] tile_bytes The size of a tile, in bytes.
+  WarmProgress(uint64_t total_tiles, uint64_t tile_bytes)
+      : total_tiles_(total_tiles), tile_bytes_(tile_bytes) {}
+
+  /// @brief Gets the number of tiles to load.
+  /// @return The number of tiles selected when the warm-up started, less the
+  /// tiles found in the caches.
+  auto total_tiles() const -> uint64_t;
+
+  /// @brief Gets the number of tiles loaded.
+  /// @return The number of tiles loaded so far.
+  auto loaded_tiles() const -> uint64_t;
+
+  /// @brief Gets the number of tiles found in the caches, not loaded again.
+  /// @return The number of tiles skipped so far.
+  auto skipped_tiles() const -> uint64_t;
+
+  /// @brief Gets the memory used by the tiles loaded.
+  /// @return The number of bytes loaded so far.
+  auto loaded_bytes() const -> uint64_t;
+
+  /// @brief Gets the fraction of the tiles loaded.
+  /// @return A value between 0 and 1, 1 if there is nothing to load.
+  auto fraction() const -> double;
+
+  /// @brief Checks if the warm-up is over.
+  /// @return True once every tile is loaded, or the warm-up was cancelled
+  /// or failed.
+  auto done() const -> bool;
+
+  /// @brief Asks the warm-up to stop after the current batch of tiles.
+  auto cancel() -> void;
+
+  /// @brief Checks if the warm-up was asked to stop.
+  /// @return True if cancel was called.
+  auto cancelled() const -> bool;
+
+  /// @brief Waits for the end of the warm-up.
+  ///
+  /// @throw std::runtime_error if loading a tile failed.
+  auto wait() const -> void;
+
+  /// @brief Records a batch of tiles loaded.
+  /// @param[in] tiles The number of tiles loaded.
+  auto advance(uint64_t tiles) -> void;
+
+  /// @brief Records tiles found in the caches, removing them from the tiles
+  /// to load.
+  /// @param[in] tiles The number of tiles skipped.
+  auto skip(uint64_t tiles) -> void;
+
+  /// @brief Records the end of the warm-up.
+  /// @param[in] error The message of the error that stopped the warm-up, or
+  /// an empty string on success.
+  auto finish(std::string error = {}) -> void;
+
+ private:
+  /// @brief Mutex protecting the state.
+  mutable std::mutex mutex_{};
+  /// @brief Signals the end of the warm-up.
+  mutable std::condition_variable finished_{};
+  /// @brief Number of tiles to load.
+  uint64_t total_tiles_;
+  /// @brief Size of a tile, in bytes.
+  uint64_t tile_bytes_;
+  /// @brief Number of tiles loaded.
+  uint64_t loaded_tiles_{0};
+  /// @brief Number of tiles found in the caches.
+  uint64_t skipped_tiles_{0};
+  /// @brief True once the warm-up is over.
+  bool done_{false};
+  /// @brief True if the warm-up was asked to stop.
+  bool cancelled_{false};
+  /// @brief Message of the error that stopped the warm-up.
+  std::string error_{};
+};
+
+}  // namespace hydrosheds
@@ -0,0 +1,205 @@
+#include "hydrosheds/approx_transform.hpp"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <cmath>
+
+namespace hydrosheds {
+
+ApproxTransform::ApproxTransform(OGRCoordinateTransformation *transform,
+                                 const std::array<double, 6> &geotransform,
+                                 double max_error, size_t cell_pixels)
+    : transform_(transform),
+      scale_x_(1.0 / std::abs(geotransform[1])),
+      scale_y_(1.0 / std::abs(geotransform[5])),
+      max_error_(max_error),
+      cell_pixels_(cell_pixels) {}
+
+auto ApproxTransform::estimate_cell_size(double x, double y) -> bool {
+  // Measure the number of pixels covered by a small step of the input.
+  auto step = std::max(std::abs(x), std::abs(y)) * 1e-6 + 1e-9;
+  auto xs = std::array<double, 3>{x, x + step, x};
+  auto ys = std::array<double, 3>{y, y, y + step};
+  auto success = std::array<int, 3>{};
+  if (!transform_->Transform(3, xs.data(), ys.data(), nullptr,
+                             success.data()) ||
+      !success[0] || !success[1] || !success[2]) {
+    return false;
+  }
+  auto pixels = std::max(std::hypot((xs[1] - xs[0]) * scale_x_,
+                                    (ys[1] - ys[0]) * scale_y_),
+                         std::hypot((xs[2] - xs[0]) * scale_x_,
+                                    (ys[2] - ys[0]) * scale_y_)) /
+                step;
+  if (!std::isfinite(pixels) || pixels <= 0) {
+    return false;
+  }
+  exponent_ = static_cast<int32_t>(
+      std::lround(std::log2(static_cast<double>(cell_pixels_) / pixels)));
+  estimated_ = true;
+  return true;
+}
+
+auto ApproxTransform::build(const CellKey &key) const -> Cell {
+  auto size = cell_size(key.exponent);
+  auto x0 = static_cast<double>(key.x) * size;
+  auto y0 = static_cast<double>(key.y) * size;
+  auto x1 = x0 + size;
+  auto y1 = y0 + size;
+  auto xm = x0 + size / 2;
+  auto ym = y0 + size / 2;
+
+  // The corners, then the middle of the edges and the center.
+  auto xs = std::array<double, 9>{x0, x1, x0, x1, xm, xm, x0, x1, xm};
+  auto ys = std::array<double, 9>{y0, y0, y1, y1, y0, y1, ym, ym, ym};
+  auto us = std::array<double, 9>{0, 1, 0, 1, 0.5, 0.5, 0, 1, 0.5};
+  auto vs = std::array<double, 9>{0, 0, 1, 1, 0, 1, 0.5, 0.5, 0.5};
+  auto success = std::array<int, 9>{};
+  auto result = Cell();
+  if (!transform_->Transform(xs.size(), xs.data(), ys.data(), nullptr,
+                             success.data()) ||
+      std::find(success.begin(), success.end(), 0) != success.end()) {
+    result.exact = true;
+    return result;
+  }
+
+  auto &c = result.coefficients;
+  c[0] = xs[0];
+  c[1] = xs[1] - xs[0];
+  c[2] = xs[2] - xs[0];
+  c[3] = xs[0] - xs[1] - xs[2] + xs[3];
+  c[4] = ys[0];
+  c[5] = ys[1] - ys[0];
+  c[6] = ys[2] - ys[0];
+  c[7] = ys[0] - ys[1] - ys[2] + ys[3];
+
+  auto error = 0.0;
+  for (size_t ix = 4; ix < xs.size(); ++ix) {
+    auto u = us[ix];
+    auto v = vs[ix];
+    auto x = c[0] + c[1] * u + v * (c[2] + c[3] * u);
+    auto y = c[4] + c[5] * u + v * (c[6] + c[7] * u);
+    error = std::max({error, std::abs(x - xs[ix]) * scale_x_,
+                      std::abs(y - ys[ix]) * scale_y_});
+  }
+  // The negated test catches the NaN.
+  if (!(error <= max_error_)) {
+    if (key.exponent > exponent_ - static_cast<int32_t>(kMaxDepth)) {
+      result.split = true;
+    } else {
+      result.exact = true;
+    }
+  }
+  return result;
+}
+
+auto ApproxTransform::find(double x, double y, double &u, double &v)
+    -> const Cell & {
+  // The cells split by the calls of another scale are followed as well:
+  // the grids nest.
+  for (auto exponent = exponent_;; --exponent) {
+    auto size = cell_size(exponent);
+    auto fx = std::floor(x / size);
+    auto fy = std::floor(y / size);
+    auto key = CellKey{exponent, static_cast<int64_t>(fx),
+                       static_cast<int64_t>(fy)};
+    auto it = cells_.find(key);
+    if (it == cells_.end()) {
+      it = cells_.emplace(key, build(key)).first;
+    }
+    if (!it->second.split) {
+      u = x / size - fx;
+      v = y / size - fy;
+      return it->second;
+    }
+  }
+}
+
+auto ApproxTransform::transform(size_t size, double *x, double *y,
+                                int *success) -> void {
+  if (size == 0) {
+    return;
+  }
+  // Estimate the size of the cells around the first points of the call that
+  // can be transformed: the scale of the transformation varies across the
+  // input space. The previous size is kept if none can.
+  for (size_t ix = 0; ix < std::min(size, kMaxProbes); ++ix) {
+    if (std::isfinite(x[ix]) && std::isfinite(y[ix]) &&
+        estimate_cell_size(x[ix], y[ix])) {
+      break;
+    }
+  }
+  if (!estimated_) {
+    transform_->Transform(size, x, y, nullptr, success);
+    return;
+  }
+  // The references to the cells stay valid until the grid is cleared.
+  if (cells_.size() > kMaxCells) {
+    cells_.clear();
+  }
+
+  owners_.resize(size);
+  u_.resize(size);
+  v_.resize(size);
+  exact_.clear();
+  exact_x_.clear();
+  exact_y_.clear();
+  auto limit = kMaxCoordinate * cell_size(exponent_);
+  for (size_t ix = 0; ix < size; ++ix) {
+    const Cell *cell = nullptr;
+    // The points too far from the origin for an index of cell are
+    // transformed exactly.
+    if (std::abs(x[ix]) < limit && std::abs(y[ix]) < limit) {
+      cell = &find(x[ix], y[ix], u_[ix], v_[ix]);
+    }
+    if (cell == nullptr || cell->exact) {
+      owners_[ix] = nullptr;
+      u_[ix] = v_[ix] = 0;
+      exact_.push_back(ix);
+      exact_x_.push_back(x[ix]);
+      exact_y_.push_back(y[ix]);
+    } else {
+      owners_[ix] = cell;
+    }
+  }
+
+  // Gather the coefficients of the cells, then interpolate all the points
+  // with vectorized operations.
+  for (auto &item : gathered_) {
+    item.resize(size);
+  }
+  for (size_t ix = 0; ix < size; ++ix) {
+    const auto *cell = owners_[ix];
+    for (size_t jx = 0; jx < gathered_.size(); ++jx) {
+      gathered_[jx][ix] = cell ? cell->coefficients[jx] : 0.0;
+    }
+  }
+  using Array = Eigen::Map<Eigen::ArrayXd>;
+  auto n = static_cast<Eigen::Index>(size);
+  auto u = Array(u_.data(), n);
+  auto v = Array(v_.data(), n);
+  auto coefficient = [&](size_t jx) {
+    return Array(gathered_[jx].data(), n);
+  };
+  Array(x, n) = coefficient(0) + coefficient(1) * u +
+                v * (coefficient(2) + coefficient(3) * u);
+  Array(y, n) = coefficient(4) + coefficient(5) * u +
+                v * (coefficient(6) + coefficient(7) * u);
+  std::fill(success, success + size, 1);
+
+  // Transform the remaining points exactly, in a single call.
+  if (exact_.empty()) {
+    return;
+  }
+  exact_success_.assign(exact_.size(), 0);
+  transform_->Transform(exact_.size(), exact_x_.data(), exact_y_.data(),
+                        nullptr, exact_success_.data());
+  for (size_t ix = 0; ix < exact_.size(); ++ix) {
+    auto point = exact_[ix];
+    x[point] = exact_x_[ix];
+    y[point] = exact_y_[ix];
+    success[point] = exact_success_[ix];
+  }
+}
+
+}  // namespace hydrosheds
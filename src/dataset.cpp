@@ -1,29 +1,57 @@
 #include "hydrosheds/dataset.hpp"
 
+#include <cpl_string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <limits>
+#include <numeric>
+#include <set>
+#include <thread>
+
+#include "hydrosheds/file_identity.hpp"
 #include "hydrosheds/parallel_for.hpp"
 
 namespace hydrosheds {
 
-// Create a coordinate transformation from the dataset's projection to lat/lon
-inline auto create_coordinate_transformation(const GDALDatasetSmartPtr &dataset,
-                                             const int espg_code)
-    -> OGRCoordinateTransformationSmartPtr {
-  OGRSpatialReference srs;
-  const char *wkt = dataset->GetProjectionRef();
-  srs.importFromWkt(&wkt);
-  OGRSpatialReference srs_latlon;
-  if (srs_latlon.importFromEPSG(espg_code) != OGRERR_NONE) {
-    throw std::runtime_error("Invalid EPSG code: " + std::to_string(espg_code));
-  }
-  return OGRCoordinateTransformationSmartPtr(
-      OGRCreateCoordinateTransformation(&srs_latlon, &srs),
-      [](OGRCoordinateTransformation *ct) {
-        OCTDestroyCoordinateTransformation(ct);
-      });
+// Order of precedence of the classes when several datasets cover a point
+inline auto class_rank(PointClass item) -> int {
+  switch (item) {
+    case PointClass::kWater:
+      return 3;
+    case PointClass::kLand:
+      return 2;
+    case PointClass::kNoData:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+// Orders the tiles by row, so that the adjacent tiles follow each other.
+inline auto row_major_less(const TileKey &lhs, const TileKey &rhs) -> bool {
+  return std::tie(std::get<1>(lhs), std::get<0>(lhs)) <
+         std::tie(std::get<1>(rhs), std::get<0>(rhs));
+}
+
+Dataset::~Dataset() {
+  // Stop the warm-ups still running, they use the caches of the object.
+  std::lock_guard<std::mutex> lock(*warm_mutex_);
+  for (auto &[progress, thread] : warm_jobs_) {
+    progress->cancel();
+    thread.join();
+  }
 }
 
 auto Dataset::init_dataset_info(const std::string &path)
     -> std::unique_ptr<DatasetInfo> {
+  if (std::filesystem::path(path).extension() == ".lqt") {
+    return init_quadtree_info(path);
+  }
+
   auto dataset = GDALDatasetSmartPtr(
       reinterpret_cast<GDALDataset *>(GDALOpen(path.c_str(), GA_ReadOnly)),
       [](GDALDataset *ds) { GDALClose(ds); });
@@ -41,15 +69,109 @@ auto Dataset::init_dataset_info(const std::string &path)
 
   BBox bbox(geotransform, x_size, y_size);
 
-  auto transform = create_coordinate_transformation(dataset, espg_code_);
+  auto transform =
+      create_coordinate_transformation(dataset->GetProjectionRef(), espg_code_);
   if (!transform) {
     throw std::runtime_error(
         "Failed to create coordinate transformation for file: " + path);
   }
 
-  return std::make_unique<DatasetInfo>(
+  int has_nodata = 0;
+  auto nodata = dataset->GetRasterBand(1)->GetNoDataValue(&has_nodata);
+
+  auto result = std::make_unique<DatasetInfo>(
       std::move(dataset), std::move(transform), std::move(geotransform),
       std::make_unique<std::mutex>(), std::move(bbox), x_size, y_size);
+  if (has_nodata && nodata >= 0 && nodata <= 255) {
+    result->nodata = static_cast<int>(nodata);
+  }
+  auto **files = result->dataset->GetFileList();
+  for (auto **item = files; item != nullptr && *item != nullptr; ++item) {
+    result->files.emplace_back(*item);
+  }
+  CSLDestroy(files);
+  result->projection = result->dataset->GetProjectionRef();
+  result->geographic = is_geographic(result->projection.c_str());
+
+  // Tiled GeoTIFF files whose tiles match the cache are read directly.
+  result->tiff = TiffTileReader::open(path, tile_size_);
+  if (result->tiff && (result->tiff->x_size() != x_size ||
+                       result->tiff->y_size() != y_size)) {
+    result->tiff.reset();
+  }
+
+  // Otherwise, the blocks read by GDAL are copied to the tiles. They are
+  // dropped if each block read is entirely copied to a single tile.
+  int block_x = 0;
+  int block_y = 0;
+  result->dataset->GetRasterBand(1)->GetBlockSize(&block_x, &block_y);
+  result->drop_blocks =
+      block_cache_ == BlockCacheMode::kDrop ||
+      (block_cache_ == BlockCacheMode::kAuto && block_x > 0 && block_y > 0 &&
+       tile_size_ % static_cast<size_t>(block_x) == 0 &&
+       tile_size_ % static_cast<size_t>(block_y) == 0);
+  return result;
+}
+
+auto Dataset::init_quadtree_info(const std::string &path)
+    -> std::unique_ptr<DatasetInfo> {
+  auto quadtree = std::make_unique<LinearQuadtree>(LinearQuadtree::load(path));
+  const auto &geotransform = quadtree->geotransform();
+  auto x_size = quadtree->x_size();
+  auto y_size = quadtree->y_size();
+
+  BBox bbox(geotransform, x_size, y_size);
+
+  auto transform = create_coordinate_transformation(
+      quadtree->projection().c_str(), espg_code_);
+  if (!transform) {
+    throw std::runtime_error(
+        "Failed to create coordinate transformation for file: " + path);
+  }
+
+  auto result = std::make_unique<DatasetInfo>(
+      GDALDatasetSmartPtr(nullptr, [](GDALDataset *ds) { GDALClose(ds); }),
+      std::move(transform), geotransform, std::make_unique<std::mutex>(),
+      std::move(bbox), x_size, y_size);
+  result->projection = quadtree->projection();
+  result->geographic = is_geographic(result->projection.c_str());
+  result->quadtree = std::move(quadtree);
+  return result;
+}
+
+auto Dataset::init_pyramid(const std::string &path,
+                           const std::string &directory,
+                           DatasetInfo &dataset_info) -> void {
+  auto file = std::filesystem::path();
+  // The pyramids of the datasets that are not local files are not saved.
+  auto identity =
+      raster_identity(dataset_info.files, dataset_info.geotransform);
+  auto hash = path_hash(path);
+  if (!directory.empty() && identity && hash) {
+    // The name of the file holds a hash of the path of the dataset, and the
+    // file the identity of the dataset when the pyramid was built.
+    file = std::filesystem::path(directory) /
+           std::filesystem::path(path).stem().concat("-" + to_hex(*hash) +
+                                                     ".pyramid");
+    // Reuse the pyramid saved by a previous run if it matches the dataset.
+    if (std::filesystem::exists(file)) {
+      try {
+        dataset_info.pyramid = std::make_unique<MaskPyramid>(
+            MaskPyramid::load(file.string(), dataset_info.x_size,
+                              dataset_info.y_size, *identity));
+        return;
+      } catch (const std::runtime_error &) {
+        // The file is corrupted, stale or written by an older version:
+        // rebuild it.
+      }
+    }
+  }
+  dataset_info.pyramid = std::make_unique<MaskPyramid>(MaskPyramid::build(
+      dataset_info.dataset->GetRasterBand(1), dataset_info.x_size,
+      dataset_info.y_size, dataset_info.nodata));
+  if (!file.empty()) {
+    dataset_info.pyramid->save(file.string(), *identity);
+  }
 }
 
 // auto Dataset::display_dataset_info(
@@ -69,59 +191,1582 @@ auto Dataset::init_dataset_info(const std::string &path)
 //   }
 // }
 
-auto Dataset::allocate_cache(size_t num_threads) const
-    -> std::vector<DatsetCache> {
+auto Dataset::allocate_cache(size_t node) const -> std::vector<DatsetCache> {
   std::vector<DatsetCache> cache;
-  cache.reserve(num_threads);
-  for (auto &dataset : base_datasets_) {
-    cache.emplace_back(dataset.get(), TileCache(max_cache_size_));
+  cache.reserve(base_datasets_.size());
+  for (size_t ix = 0; ix < base_datasets_.size(); ++ix) {
+    auto &dataset = base_datasets_[ix];
+    auto transform = OGRCoordinateTransformationSmartPtr(
+        dataset->transform->Clone(), [](OGRCoordinateTransformation *ct) {
+          OCTDestroyCoordinateTransformation(ct);
+        });
+    if (!transform) {
+      throw std::runtime_error("Failed to clone coordinate transformation.");
+    }
+    cache.emplace_back(dataset.get(),
+                       TileCache(std::min(kLocalCacheSize, max_cache_size_)),
+                       dataset->shared_caches[node].get(),
+                       arenas_[node].get(), std::move(transform));
+    cache.back().index = ix;
+    cache.back().node = node;
+    cache.back().transformer.wrap_longitude =
+        dataset->geographic && is_geographic(espg_code_);
+    if (max_transform_error_ > 0) {
+      auto &transformer = cache.back().transformer;
+      transformer.approx = std::make_unique<ApproxTransform>(
+          transformer.transform.get(), dataset->geotransform,
+          max_transform_error_, tile_size_);
+    }
   }
   return cache;
 }
 
+auto Dataset::acquire_context(size_t node) const -> QueryContextPtr {
+  auto release = [this](QueryContext *context) {
+    std::lock_guard<std::mutex> lock(*contexts_mutex_);
+    idle_contexts_[context->node].emplace_back(context);
+  };
+  {
+    std::lock_guard<std::mutex> lock(*contexts_mutex_);
+    auto &idle = idle_contexts_[node];
+    if (!idle.empty()) {
+      auto context = QueryContextPtr(idle.back().release(), release);
+      idle.pop_back();
+      return context;
+    }
+  }
+  return QueryContextPtr(new QueryContext{node, allocate_cache(node)},
+                         release);
+}
+
+auto Dataset::registered_transforms(int espg_code) const
+    -> const std::vector<Transformer> & {
+  std::lock_guard<std::mutex> lock(*registry_mutex_);
+  auto it = registry_.find(espg_code);
+  if (it != registry_.end()) {
+    return it->second;
+  }
+  auto transforms = std::vector<Transformer>();
+  for (const auto &item : base_datasets_) {
+    auto &transformer = transforms.emplace_back();
+    transformer.transform = create_coordinate_transformation(
+        item->projection.c_str(), espg_code);
+    if (!transformer.transform) {
+      throw std::runtime_error(
+          "Failed to create coordinate transformation from EPSG:" +
+          std::to_string(espg_code));
+    }
+    transformer.filter_bbox =
+        same_coordinate_system(item->projection.c_str(), espg_code);
+    transformer.wrap_longitude = item->geographic && is_geographic(espg_code);
+  }
+  return registry_.emplace(espg_code, std::move(transforms)).first->second;
+}
+
+auto Dataset::select_transformer(DatsetCache &dataset_cache,
+                                 int espg_code) const -> Transformer & {
+  if (espg_code == espg_code_) {
+    return dataset_cache.transformer;
+  }
+  auto it = dataset_cache.transformers.find(espg_code);
+  if (it != dataset_cache.transformers.end()) {
+    return it->second;
+  }
+
+  // Clone the transformation registered for the coordinate system, the
+  // transformations being not thread-safe.
+  const auto &prototype = registered_transforms(espg_code)[dataset_cache.index];
+  auto transformer = Transformer();
+  {
+    std::lock_guard<std::mutex> lock(*registry_mutex_);
+    transformer.transform = OGRCoordinateTransformationSmartPtr(
+        prototype.transform->Clone(), [](OGRCoordinateTransformation *ct) {
+          OCTDestroyCoordinateTransformation(ct);
+        });
+  }
+  if (!transformer.transform) {
+    throw std::runtime_error("Failed to clone coordinate transformation.");
+  }
+  transformer.filter_bbox = prototype.filter_bbox;
+  transformer.wrap_longitude = prototype.wrap_longitude;
+  if (max_transform_error_ > 0) {
+    transformer.approx = std::make_unique<ApproxTransform>(
+        transformer.transform.get(), dataset_cache.dataset_info->geotransform,
+        max_transform_error_, tile_size_);
+  }
+  return dataset_cache.transformers.emplace(espg_code, std::move(transformer))
+      .first->second;
+}
+
+auto Dataset::resolve_espg_code(const std::optional<int> &espg_code) const
+    -> int {
+  auto result = espg_code.value_or(espg_code_);
+  // Build the transformations before starting the threads, so that an
+  // invalid code is reported once.
+  if (result != espg_code_) {
+    registered_transforms(result);
+  }
+  return result;
+}
+
 auto Dataset::is_water(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
-                       size_t num_threads) const -> VectorBool {
+                       size_t num_threads, bool fill_value,
+                       const std::optional<int> &espg_code) const
+    -> VectorBool {
+  auto result = VectorBool(lon.size());
+  classify(lon, lat, num_threads, resolve_espg_code(espg_code),
+           [&](const ChunkBuffers &buffers) {
+             const auto &points = buffers.points;
+             for (size_t ix = 0; ix < points.size(); ++ix) {
+               auto item = static_cast<PointClass>(buffers.classes(ix));
+               result(points[ix]) =
+                   item == PointClass::kWater ||
+                   (item == PointClass::kOutside && fill_value);
+             }
+           });
+  return result;
+}
+
+auto Dataset::is_water_packed(ConstRefVectorFloat64 lon,
+                              ConstRefVectorFloat64 lat, size_t num_threads,
+                              bool fill_value,
+                              const std::optional<int> &espg_code) const
+    -> VectorUInt8 {
+  auto result = VectorUInt8(VectorUInt8::Zero((lon.size() + 7) / 8));
+  classify(lon, lat, num_threads, resolve_espg_code(espg_code),
+           [&](const ChunkBuffers &buffers) {
+             const auto &points = buffers.points;
+             // The bits of a byte are gathered, then merged at once: the
+             // bytes at the edges of the chunks are shared with the other
+             // workers.
+             auto flush = [&](size_t byte, uint8_t bits) {
+               if (bits != 0) {
+                 std::atomic_ref<uint8_t>(result(byte))
+                     .fetch_or(bits, std::memory_order_relaxed);
+               }
+             };
+             auto byte = size_t(0);
+             auto bits = uint8_t(0);
+             for (size_t ix = 0; ix < points.size(); ++ix) {
+               auto item = static_cast<PointClass>(buffers.classes(ix));
+               if (points[ix] / 8 != byte) {
+                 flush(byte, bits);
+                 byte = points[ix] / 8;
+                 bits = 0;
+               }
+               if (item == PointClass::kWater ||
+                   (item == PointClass::kOutside && fill_value)) {
+                 bits |= static_cast<uint8_t>(0x80U >> (points[ix] % 8));
+               }
+             }
+             flush(byte, bits);
+           });
+  return result;
+}
+
+auto Dataset::water_indices(ConstRefVectorFloat64 lon,
+                            ConstRefVectorFloat64 lat, size_t num_threads,
+                            bool fill_value,
+                            const std::optional<int> &espg_code) const
+    -> VectorInt64 {
+  // Each worker collects the water points of its chunks in its buffers, in
+  // order; the runs of the workers are concatenated by their first point.
+  auto runs = std::vector<std::pair<size_t, std::vector<int64_t>>>();
+  auto mutex = std::mutex();
+  classify(
+      lon, lat, num_threads, resolve_espg_code(espg_code),
+      [&](ChunkBuffers &buffers) {
+        const auto &points = buffers.points;
+        for (size_t ix = 0; ix < points.size(); ++ix) {
+          auto item = static_cast<PointClass>(buffers.classes(ix));
+          if (item == PointClass::kWater ||
+              (item == PointClass::kOutside && fill_value)) {
+            buffers.selected.push_back(static_cast<int64_t>(points[ix]));
+          }
+        }
+      },
+      [&](size_t first, ChunkBuffers &buffers) {
+        std::lock_guard<std::mutex> lock(mutex);
+        runs.emplace_back(first, std::move(buffers.selected));
+        buffers.selected.clear();
+      });
+  std::sort(runs.begin(), runs.end(), [](const auto &lhs, const auto &rhs) {
+    return lhs.first < rhs.first;
+  });
+
+  auto size = size_t(0);
+  for (const auto &[first, run] : runs) {
+    size += run.size();
+  }
+  auto result = VectorInt64(static_cast<Eigen::Index>(size));
+  auto bounds = std::vector<size_t>{0};
+  for (const auto &[first, run] : runs) {
+    std::copy(run.begin(), run.end(), result.data() + bounds.back());
+    bounds.push_back(bounds.back() + run.size());
+  }
+  // The workers of a node share the points of the node: their runs
+  // interleave with the ones of the other nodes and are merged.
+  if (topology_.size() > 1) {
+    auto *data = result.data();
+    for (size_t width = 1; width < runs.size(); width *= 2) {
+      for (size_t ix = 0; ix + width < runs.size(); ix += 2 * width) {
+        std::inplace_merge(data + bounds[ix], data + bounds[ix + width],
+                           data + bounds[std::min(ix + 2 * width,
+                                                  runs.size())]);
+      }
+    }
+  }
+  return result;
+}
+
+auto Dataset::count_water_points(ConstRefVectorFloat64 lon,
+                                 ConstRefVectorFloat64 lat,
+                                 size_t num_threads, bool fill_value,
+                                 const std::optional<int> &espg_code) const
+    -> uint64_t {
+  auto count = std::atomic<uint64_t>(0);
+  classify(lon, lat, num_threads, resolve_espg_code(espg_code),
+           [&](const ChunkBuffers &buffers) {
+             const auto &classes = buffers.classes;
+             auto water =
+                 (classes == static_cast<uint8_t>(PointClass::kWater)).count();
+             if (fill_value) {
+               water +=
+                   (classes == static_cast<uint8_t>(PointClass::kOutside))
+                       .count();
+             }
+             count.fetch_add(static_cast<uint64_t>(water),
+                             std::memory_order_relaxed);
+           });
+  return count;
+}
+
+auto Dataset::classify(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                       size_t num_threads,
+                       const std::optional<int> &espg_code) const
+    -> std::tuple<VectorUInt8, VectorInt16> {
+  auto classes = VectorUInt8(lon.size());
+  auto datasets = VectorInt16(lon.size());
+  classify(lon, lat, num_threads, resolve_espg_code(espg_code),
+           [&](const ChunkBuffers &buffers) {
+             const auto &points = buffers.points;
+             for (size_t ix = 0; ix < points.size(); ++ix) {
+               classes(points[ix]) = buffers.classes(ix);
+               datasets(points[ix]) = buffers.datasets(ix);
+             }
+           });
+  return {std::move(classes), std::move(datasets)};
+}
+
+auto Dataset::prepare(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                      size_t num_threads,
+                      const std::optional<int> &espg_code) const
+    -> PreparedPoints {
   if (lon.size() != lat.size()) {
     throw std::invalid_argument("lon and lat must have the same size");
   }
-  auto result = VectorBool(lon.size());
-  result.setZero();
+  auto code = resolve_espg_code(espg_code);
+  auto coverage = batch_coverage(lon, lat, code);
 
-  auto worker = [&](size_t start, size_t end) {
-    auto cache = allocate_cache(num_threads);
-    for (size_t ix = start; ix < end; ix++) {
-      result(ix) = is_water(lon(ix), lat(ix), cache);
+  // Each worker collects the addresses of its points, merged at the end.
+  auto addresses = std::vector<PreparedPoints::Address>();
+  auto mutex = std::mutex();
+  auto worker = [&](size_t start, size_t end,
+                    const std::atomic<bool> &cancelled) {
+    auto context = acquire_context(0);
+    auto &buffers = context->buffers;
+    auto &indices = buffers.indices;
+    auto local = std::vector<PreparedPoints::Address>();
+    for (auto first = start; first < end && !cancelled; first += kChunkSize) {
+      auto last = std::min(first + kChunkSize, end);
+      buffers.points.resize(last - first);
+      std::iota(buffers.points.begin(), buffers.points.end(), first);
+      for (size_t jx = 0; jx < context->cache.size(); ++jx) {
+        if (coverage[jx] == BatchCoverage::kNone) {
+          continue;
+        }
+        auto &item = context->cache[jx];
+        locate(item, select_transformer(item, code), lon, lat,
+               buffers.points, coverage[jx] == BatchCoverage::kFull,
+               indices);
+        for (size_t ix = 0; ix < indices.index.size(); ++ix) {
+          auto pixel_x = indices.pixel_x[ix];
+          auto pixel_y = indices.pixel_y[ix];
+          local.push_back(
+              {static_cast<uint32_t>(jx),
+               TileKey(pixel_x / tile_size_, pixel_y / tile_size_),
+               static_cast<uint32_t>((pixel_y % tile_size_) * tile_size_ +
+                                     pixel_x % tile_size_),
+               buffers.points[indices.index[ix]]});
+        }
+      }
     }
+    std::lock_guard<std::mutex> lock(mutex);
+    addresses.insert(addresses.end(), local.begin(), local.end());
   };
   parallel_for(worker, lon.size(), num_threads);
+
+  auto grids = std::vector<PreparedPoints::Grid>();
+  for (const auto &item : base_datasets_) {
+    grids.push_back({item->geotransform, item->x_size, item->y_size});
+  }
+  return {static_cast<size_t>(lon.size()), tile_size_, std::move(grids),
+          std::move(addresses)};
+}
+
+auto Dataset::is_water(const PreparedPoints &points, size_t num_threads,
+                       bool fill_value) const -> VectorBool {
+  auto classes = std::get<0>(classify(points, num_threads));
+  auto result =
+      VectorBool(classes == static_cast<uint8_t>(PointClass::kWater));
+  if (fill_value) {
+    result = result ||
+             classes == static_cast<uint8_t>(PointClass::kOutside);
+  }
   return result;
 }
 
-auto Dataset::is_water(double lon, double lat,
-                       std::vector<DatsetCache> &dataset_cache_collection) const
-    -> bool {
-  for (auto &item : dataset_cache_collection) {
-    if (item.dataset_info->bbox.contains(lon, lat)) {
-      if (is_water(lon, lat, item)) {
-        return true;
+auto Dataset::classify(const PreparedPoints &points, size_t num_threads) const
+    -> std::tuple<VectorUInt8, VectorInt16> {
+  const auto &grids = points.grids();
+  auto compatible = points.tile_size() == tile_size_ &&
+                    grids.size() == base_datasets_.size();
+  for (size_t ix = 0; compatible && ix < grids.size(); ++ix) {
+    const auto &item = *base_datasets_[ix];
+    compatible = grids[ix] == PreparedPoints::Grid{item.geotransform,
+                                                   item.x_size, item.y_size};
+  }
+  if (!compatible) {
+    throw std::invalid_argument(
+        "the points were prepared for datasets with other grids or another "
+        "tile size");
+  }
+
+  auto size = static_cast<Eigen::Index>(points.size());
+  auto classes = VectorUInt8(size);
+  auto datasets = VectorInt16(size);
+  classes.setConstant(static_cast<uint8_t>(PointClass::kOutside));
+  datasets.setConstant(-1);
+  // A point appears once per dataset: the groups of a dataset are processed
+  // in parallel, the datasets one after the other to apply the precedence.
+  for (size_t jx = 0; jx < base_datasets_.size(); ++jx) {
+    auto groups = points.groups(jx);
+    auto worker = [&](size_t start, size_t end,
+                      const std::atomic<bool> &cancelled) {
+      auto context = acquire_context(0);
+      auto &item = context->cache[jx];
+      for (auto ix = start; ix < end && !cancelled; ++ix) {
+        classify_group(points, groups[ix], jx, item, classes, datasets);
+      }
+    };
+    parallel_for(worker, groups.size(), num_threads);
+  }
+  return {std::move(classes), std::move(datasets)};
+}
+
+auto Dataset::read_window(const DatasetInfo &dataset_info, size_t x_offset,
+                          size_t y_offset, size_t width, size_t height,
+                          char *buffer, size_t line_space) const -> void {
+  auto *band = dataset_info.dataset->GetRasterBand(1);
+  if (band->RasterIO(GF_Read, static_cast<int>(x_offset),
+                     static_cast<int>(y_offset), static_cast<int>(width),
+                     static_cast<int>(height), buffer, static_cast<int>(width),
+                     static_cast<int>(height), GDT_Byte, 1,
+                     static_cast<GSpacing>(line_space)) != CE_None) {
+    throw std::runtime_error("Failed to read tile from dataset.");
+  }
+
+  // The tile cache now holds the pixels: release the copy held by the
+  // block cache of GDAL.
+  if (dataset_info.drop_blocks) {
+    int block_width = 0;
+    int block_height = 0;
+    band->GetBlockSize(&block_width, &block_height);
+    auto block_x = static_cast<size_t>(block_width);
+    auto block_y = static_cast<size_t>(block_height);
+    auto x_begin = x_offset / block_x;
+    auto y_begin = y_offset / block_y;
+    auto x_end = (x_offset + width + block_x - 1) / block_x;
+    auto y_end = (y_offset + height + block_y - 1) / block_y;
+    for (auto y = y_begin; y < y_end; ++y) {
+      for (auto x = x_begin; x < x_end; ++x) {
+        band->FlushBlock(static_cast<int>(x), static_cast<int>(y), false);
+      }
+    }
+    dropped_blocks_.fetch_add((x_end - x_begin) * (y_end - y_begin),
+                              std::memory_order_relaxed);
+  }
+}
+
+auto Dataset::read_tile_runs(const DatasetInfo &dataset_info,
+                             ChunkBuffers &buffers) const -> void {
+  const auto &reads = buffers.reads;
+  auto &strip = buffers.strip;
+  std::lock_guard<std::mutex> lock(*dataset_info.mutex);
+  for (size_t first = 0; first < reads.size();) {
+    // The tiles are sorted by row: merge the adjacent tiles of a row.
+    auto last = first + 1;
+    while (last < reads.size() && last - first < kMaxTileRun &&
+           reads[last].tile_y == reads[first].tile_y &&
+           reads[last].tile_x == reads[last - 1].tile_x + 1) {
+      ++last;
+    }
+    auto x_offset = reads[first].tile_x * tile_size_;
+    auto y_offset = reads[first].tile_y * tile_size_;
+    auto width = std::min((last - first) * tile_size_,
+                          dataset_info.x_size - x_offset);
+    auto height = std::min(tile_size_, dataset_info.y_size - y_offset);
+    if (last - first == 1) {
+      read_window(dataset_info, x_offset, y_offset, width, height,
+                  reads[first].buffer, tile_size_);
+    } else {
+      // Read the whole run at once, then split it into the tiles.
+      strip.resize(width * height);
+      read_window(dataset_info, x_offset, y_offset, width, height,
+                  strip.data(), width);
+      for (auto ix = first; ix < last; ++ix) {
+        auto offset = (ix - first) * tile_size_;
+        auto tile_width = std::min(tile_size_, width - offset);
+        for (size_t row = 0; row < height; ++row) {
+          std::memcpy(reads[ix].buffer + row * tile_size_,
+                      strip.data() + row * width + offset, tile_width);
+        }
+      }
+      coalesced_reads_.fetch_add(1, std::memory_order_relaxed);
+    }
+    gdal_reads_.fetch_add(last - first, std::memory_order_relaxed);
+    first = last;
+  }
+}
+
+auto Dataset::load_missing_tiles(DatsetCache &dataset_cache,
+                                  const VectorUInt8 &classes,
+                                  ChunkBuffers &buffers) const -> void {
+  const auto &dataset_info = *dataset_cache.dataset_info;
+  const auto &indices = buffers.indices;
+  auto &tile_cache = dataset_cache.tile_cache;
+  auto &missing = buffers.missing;
+  missing.clear();
+  for (size_t ix = 0; ix < indices.index.size(); ++ix) {
+    if (static_cast<PointClass>(classes(indices.index[ix])) ==
+        PointClass::kWater) {
+      continue;
+    }
+    auto pixel_x = indices.pixel_x[ix];
+    auto pixel_y = indices.pixel_y[ix];
+    if (dataset_info.pyramid &&
+        dataset_info.pyramid->lookup(pixel_x, pixel_y) != Coverage::kMixed) {
+      continue;
+    }
+    auto tile_key = TileKey(pixel_x / tile_size_, pixel_y / tile_size_);
+    if (!tile_cache.is_tile_in_cache(tile_key)) {
+      missing.push_back(tile_key);
+    }
+  }
+  std::sort(missing.begin(), missing.end(), row_major_less);
+  missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+  missing.resize(std::min(missing.size(), tile_cache.max_tiles()));
+
+  auto &reads = buffers.reads;
+  auto &slots = buffers.slots;
+  auto &shared_misses = buffers.shared_misses;
+  reads.clear();
+  slots.clear();
+  shared_misses.clear();
+  for (const auto &tile_key : missing) {
+    auto tile = find_shared_tile(dataset_cache, tile_key);
+    if (!tile) {
+      shared_misses.push_back(tile_key);
+      tile = find_disk_tile(dataset_info, tile_key);
+      if (tile) {
+        dataset_cache.shared_cache->add_tile_to_cache(tile_key, tile);
+      }
+    }
+    if (tile) {
+      tile_cache.add_tile_to_cache(tile_key, std::move(tile));
+      continue;
+    }
+    slots.emplace_back(dataset_cache.arena->allocate());
+    reads.push_back({static_cast<size_t>(std::get<0>(tile_key)),
+                     static_cast<size_t>(std::get<1>(tile_key)),
+                     slots.back().get()});
+  }
+  if (prefetcher_ && !shared_misses.empty()) {
+    read_ahead(dataset_cache, shared_misses, missing);
+  }
+  // A single tile is loaded on demand, as usual.
+  if (reads.size() < 2) {
+    return;
+  }
+  read_tiles(dataset_cache, buffers);
+}
+
+auto Dataset::read_tiles(DatsetCache &dataset_cache,
+                         ChunkBuffers &buffers) const -> void {
+  const auto &dataset_info = *dataset_cache.dataset_info;
+  auto &reads = buffers.reads;
+  auto &slots = buffers.slots;
+  if (dataset_info.tiff) {
+    dataset_info.tiff->read_batch(
+        reads, static_cast<uint8_t>(std::max(dataset_info.nodata, 0)));
+    direct_reads_.fetch_add(reads.size(), std::memory_order_relaxed);
+    batches_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    read_tile_runs(dataset_info, buffers);
+  }
+  for (size_t ix = 0; ix < reads.size(); ++ix) {
+    auto tile_key = TileKey(static_cast<int>(reads[ix].tile_x),
+                            static_cast<int>(reads[ix].tile_y));
+    if (dataset_info.disk_cache) {
+      if (dataset_info.disk_cache->store(tile_key, reads[ix].buffer)) {
+        disk_writes_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    auto tile = Tile(std::move(slots[ix]));
+    dataset_cache.shared_cache->add_tile_to_cache(tile_key, tile);
+    dataset_cache.tile_cache.add_tile_to_cache(tile_key, std::move(tile));
+  }
+  slots.clear();
+}
+
+auto Dataset::classify_chunk(ConstRefVectorFloat64 lon,
+                             ConstRefVectorFloat64 lat, int espg_code,
+                             const std::vector<BatchCoverage> &coverage,
+                             std::vector<DatsetCache> &cache,
+                             ChunkBuffers &buffers) const -> void {
+  auto &classes = buffers.classes;
+  auto &datasets = buffers.datasets;
+  auto &indices = buffers.indices;
+  classes.resize(static_cast<Eigen::Index>(buffers.points.size()));
+  datasets.resize(classes.size());
+  classes.setConstant(static_cast<uint8_t>(PointClass::kOutside));
+  datasets.setConstant(-1);
+  auto queried = std::count_if(
+      coverage.begin(), coverage.end(),
+      [](BatchCoverage item) { return item != BatchCoverage::kNone; });
+  for (size_t jx = 0; jx < cache.size(); ++jx) {
+    if (coverage[jx] == BatchCoverage::kNone) {
+      continue;
+    }
+    auto &item = cache[jx];
+    locate(item, select_transformer(item, espg_code), lon, lat,
+           buffers.points, coverage[jx] == BatchCoverage::kFull, indices);
+    if (!item.dataset_info->quadtree && !item.dataset_info->preloaded) {
+      load_missing_tiles(item, classes, buffers);
+    }
+    // A single dataset queried for the batch answers for all its points.
+    if (queried == 1) {
+      for (size_t ix = 0; ix < indices.index.size(); ++ix) {
+        auto point = indices.index[ix];
+        classes(point) = static_cast<uint8_t>(
+            classify(indices.pixel_x[ix], indices.pixel_y[ix], item));
+        datasets(point) = static_cast<int16_t>(jx);
+      }
+      continue;
+    }
+    for (size_t ix = 0; ix < indices.index.size(); ++ix) {
+      auto point = indices.index[ix];
+      auto current = static_cast<PointClass>(classes(point));
+      // Once a dataset says water, the others are not queried.
+      if (current == PointClass::kWater) {
+        continue;
+      }
+      auto value = classify(indices.pixel_x[ix], indices.pixel_y[ix], item);
+      if (class_rank(value) > class_rank(current)) {
+        classes(point) = static_cast<uint8_t>(value);
+        datasets(point) = static_cast<int16_t>(jx);
+      }
+    }
+  }
+}
+
+auto Dataset::classify_group(const PreparedPoints &points,
+                             const PreparedPoints::TileGroup &group,
+                             size_t index, DatsetCache &dataset_cache,
+                             VectorUInt8 &classes,
+                             VectorInt16 &datasets) const -> void {
+  const auto &dataset_info = *dataset_cache.dataset_info;
+  const auto &point = points.points();
+  const auto &offset = points.offsets();
+  auto update = [&](size_t ix, PointClass value) {
+    if (class_rank(value) > class_rank(static_cast<PointClass>(classes(ix)))) {
+      classes(ix) = static_cast<uint8_t>(value);
+      datasets(ix) = static_cast<int16_t>(index);
+    }
+  };
+
+  // The datasets held in memory answer pixel by pixel.
+  auto x0 = static_cast<size_t>(std::get<0>(group.tile)) * tile_size_;
+  auto y0 = static_cast<size_t>(std::get<1>(group.tile)) * tile_size_;
+  if (dataset_info.quadtree || dataset_info.preloaded) {
+    for (auto ix = group.begin; ix < group.end; ++ix) {
+      if (static_cast<PointClass>(classes(point[ix])) != PointClass::kWater) {
+        update(point[ix], classify(x0 + offset[ix] % tile_size_,
+                                   y0 + offset[ix] / tile_size_,
+                                   dataset_cache));
+      }
+    }
+    return;
+  }
+
+  // The pyramid answers the points located in uniform regions. The tile is
+  // not loaded if they, or the previous datasets saying water, answer all
+  // the points.
+  auto pending = false;
+  for (auto ix = group.begin; ix < group.end; ++ix) {
+    if (static_cast<PointClass>(classes(point[ix])) == PointClass::kWater) {
+      continue;
+    }
+    if (dataset_info.pyramid) {
+      auto coverage = dataset_info.pyramid->lookup(
+          x0 + offset[ix] % tile_size_, y0 + offset[ix] / tile_size_);
+      if (coverage != Coverage::kMixed) {
+        update(point[ix], coverage == Coverage::kWater ? PointClass::kWater
+                                                       : PointClass::kLand);
+        continue;
+      }
+    }
+    pending = true;
+  }
+  if (!pending) {
+    return;
+  }
+  // The points answered by the pyramid are gathered with the others: their
+  // pixels do not change their class.
+  auto tile = dataset_cache.tile_cache.find_tile(group.tile);
+  if (!tile) {
+    load_tile_cache(group.tile, dataset_cache);
+    tile = dataset_cache.tile_cache.find_tile(group.tile);
+  }
+  const auto *pixels = reinterpret_cast<const uint8_t *>(tile.get());
+  for (auto ix = group.begin; ix < group.end; ++ix) {
+    auto value = static_cast<int>(pixels[offset[ix]]);
+    if (value == 1) {
+      update(point[ix], PointClass::kWater);
+    } else {
+      update(point[ix], value == dataset_info.nodata ? PointClass::kNoData
+                                                     : PointClass::kLand);
+    }
+  }
+}
+
+auto Dataset::dispatch_to_nodes(ConstRefVectorFloat64 lon,
+                                ConstRefVectorFloat64 lat, int espg_code,
+                                size_t num_threads,
+                                QueryContext &context) const -> void {
+  auto nodes = topology_.size();
+  // The longitudes are wrapped as in the queries: only if the coordinates
+  // of the points are geographic too.
+  auto geographic = is_geographic(espg_code);
+  auto &owner = context.owners;
+  owner.resize(lon.size());
+
+  // The owner of a point is derived from the tile holding it in the first
+  // dataset covering it. The geotransform is applied to the coordinates
+  // before their transformation: this is exact for the datasets in the
+  // coordinate system of the input, and still keeps the neighbouring points
+  // together for the others.
+  auto worker = [&](size_t start, size_t end,
+                    const std::atomic<bool> &cancelled) {
+    for (auto ix = start; ix < end && !cancelled; ++ix) {
+      auto node = ix % nodes;
+      for (size_t jx = 0; jx < base_datasets_.size(); ++jx) {
+        const auto &dataset_info = *base_datasets_[jx];
+        auto x = geographic && dataset_info.geographic
+                     ? dataset_info.bbox.wrap_longitude(lon(ix))
+                     : lon(ix);
+        if (!dataset_info.bbox.contains(x, lat(ix))) {
+          continue;
+        }
+        const auto &geotransform = dataset_info.geotransform;
+        auto tile_x = static_cast<int64_t>(
+            std::floor((x - geotransform[0]) / geotransform[1] /
+                       static_cast<double>(tile_size_)));
+        auto tile_y = static_cast<int64_t>(
+            std::floor((lat(ix) - geotransform[3]) / geotransform[5] /
+                       static_cast<double>(tile_size_)));
+        auto hash = static_cast<uint64_t>(tile_x) * 73856093U ^
+                    static_cast<uint64_t>(tile_y) * 19349663U ^
+                    static_cast<uint64_t>(jx) * 83492791U;
+        node = hash % nodes;
+        break;
       }
+      owner[ix] = static_cast<uint16_t>(node);
     }
+  };
+  parallel_for(worker, lon.size(), num_threads);
+
+  auto &result = context.node_points;
+  result.resize(nodes);
+  for (auto &item : result) {
+    item.clear();
+  }
+  for (size_t ix = 0; ix < owner.size(); ++ix) {
+    result[owner[ix]].push_back(ix);
   }
-  return false;
 }
 
-auto Dataset::is_water(double lon, double lat,
-                       DatsetCache &dataset_cache) const -> bool {
-  double x = lon;
-  double y = lat;
+template <typename Store>
+auto Dataset::classify(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                       size_t num_threads, int espg_code,
+                       const Store &store) const -> void {
+  classify(lon, lat, num_threads, espg_code, store,
+           [](size_t, ChunkBuffers &) {});
+}
+
+template <typename Store, typename Finish>
+auto Dataset::classify(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                       size_t num_threads, int espg_code, const Store &store,
+                       const Finish &finish) const -> void {
+  if (lon.size() != lat.size()) {
+    throw std::invalid_argument("lon and lat must have the same size");
+  }
+  auto coverage = batch_coverage(lon, lat, espg_code);
+
+  auto nodes = topology_.size();
+  if (nodes <= 1) {
+    auto worker = [&](size_t start, size_t end,
+                      const std::atomic<bool> &cancelled) {
+      auto context = acquire_context(0);
+      auto &cache = context->cache;
+      auto &buffers = context->buffers;
+      buffers.selected.clear();
+      for (auto first = start; first < end && !cancelled;
+           first += kChunkSize) {
+        auto last = std::min(first + kChunkSize, end);
+        buffers.points.resize(last - first);
+        std::iota(buffers.points.begin(), buffers.points.end(), first);
+        classify_chunk(lon, lat, espg_code, coverage, cache, buffers);
+        store(buffers);
+      }
+      finish(start, buffers);
+    };
+    parallel_for(worker, lon.size(), num_threads);
+    return;
+  }
+
+  // Each node processes the points whose tile it caches, with threads
+  // pinned to its CPUs so that its tiles are allocated in its memory.
+  if (num_threads == 0) {
+    num_threads = std::thread::hardware_concurrency();
+  }
+  num_threads = std::max(num_threads, nodes);
+  auto dispatch = acquire_context(0);
+  dispatch_to_nodes(lon, lat, espg_code, num_threads, *dispatch);
+  const auto &points = dispatch->node_points;
+
+  auto worker = [&](size_t start, size_t end,
+                    const std::atomic<bool> &cancelled) {
+    for (auto slot = start; slot < end && !cancelled; ++slot) {
+      auto node = slot % nodes;
+      auto rank = slot / nodes;
+      auto workers = (num_threads - node + nodes - 1) / nodes;
+      const auto &list = points[node];
+      auto share = (list.size() + workers - 1) / workers;
+      auto begin = std::min(list.size(), rank * share);
+      auto end_of_share = std::min(list.size(), begin + share);
+      if (begin == end_of_share) {
+        continue;
+      }
+      topology_.pin_current_thread(node);
+      auto context = acquire_context(node);
+      auto &cache = context->cache;
+      auto &buffers = context->buffers;
+      buffers.selected.clear();
+      for (auto first = begin; first < end_of_share && !cancelled;
+           first += kChunkSize) {
+        auto last = std::min(first + kChunkSize, end_of_share);
+        buffers.points.assign(list.begin() + static_cast<ptrdiff_t>(first),
+                              list.begin() + static_cast<ptrdiff_t>(last));
+        classify_chunk(lon, lat, espg_code, coverage, cache, buffers);
+        store(buffers);
+      }
+      finish(list[begin], buffers);
+    }
+  };
+  parallel_for(worker, num_threads, num_threads);
+}
+
+auto Dataset::locate(const DatsetCache &dataset_cache,
+                     const Transformer &transformer,
+                     ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                     const std::vector<size_t> &points, bool inside,
+                     PixelIndices &indices) const -> void {
+  const auto &dataset_info = *dataset_cache.dataset_info;
+  indices.index.clear();
+  indices.x.clear();
+  indices.y.clear();
+  // The bounding box of the dataset is expressed in its coordinate system:
+  // the points in another system are filtered once transformed. The
+  // longitudes are wrapped to the range of the dataset in the same pass.
+  const auto &bbox = dataset_info.bbox;
+  auto wrap = transformer.wrap_longitude;
+  auto filter = transformer.filter_bbox && !inside;
+  for (size_t ix = 0; ix < points.size(); ++ix) {
+    auto point = points[ix];
+    auto x = wrap ? bbox.wrap_longitude(lon(point)) : lon(point);
+    if (!filter || bbox.contains(x, lat(point))) {
+      indices.index.push_back(ix);
+      indices.x.push_back(x);
+      indices.y.push_back(lat(point));
+    }
+  }
+  auto size = indices.index.size();
+  if (size == 0) {
+    return;
+  }
+
+  // Transform the whole chunk at once, the points that cannot be transformed
+  // are flagged instead of aborting the batch.
+  indices.success.resize(size);
+  if (transformer.approx) {
+    transformer.approx->transform(size, indices.x.data(), indices.y.data(),
+                                  indices.success.data());
+  } else {
+    transformer.transform->Transform(size, indices.x.data(), indices.y.data(),
+                                     nullptr, indices.success.data());
+  }
+
+  const auto &geotransform = dataset_info.geotransform;
+  auto x = Eigen::Map<VectorFloat64>(indices.x.data(), size);
+  auto y = Eigen::Map<VectorFloat64>(indices.y.data(), size);
+  if (wrap) {
+    // The transformation may have normalized the longitudes again: wrap the
+    // columns to the 360 degrees following the western edge.
+    auto period = 360.0 / geotransform[1];
+    x = (x - geotransform[0]) / geotransform[1];
+    x = x - period * (x / period).floor();
+  } else {
+    x = (x - geotransform[0]) / geotransform[1];
+  }
+  y = (y - geotransform[3]) / geotransform[5];
+
+  // Keep the points mapping into the raster, testing the coordinates before
+  // truncating them to a pixel. The points located on the right or bottom
+  // edge of the bounding box belong to the last pixel.
+  auto x_size = static_cast<double>(dataset_info.x_size);
+  auto y_size = static_cast<double>(dataset_info.y_size);
+  indices.pixel_x.resize(size);
+  indices.pixel_y.resize(size);
+  size_t valid = 0;
+  for (size_t ix = 0; ix < size; ++ix) {
+    if (indices.success[ix] && x(ix) >= 0 && x(ix) <= x_size && y(ix) >= 0 &&
+        y(ix) <= y_size) {
+      indices.index[valid] = indices.index[ix];
+      indices.pixel_x[valid] = std::min(static_cast<size_t>(x(ix)),
+                                        dataset_info.x_size - 1);
+      indices.pixel_y[valid] = std::min(static_cast<size_t>(y(ix)),
+                                        dataset_info.y_size - 1);
+      ++valid;
+    }
+  }
+  indices.index.resize(valid);
+  indices.pixel_x.resize(valid);
+  indices.pixel_y.resize(valid);
+}
+
+auto Dataset::batch_coverage(ConstRefVectorFloat64 lon,
+                             ConstRefVectorFloat64 lat, int espg_code) const
+    -> std::vector<BatchCoverage> {
+  auto result = std::vector<BatchCoverage>(base_datasets_.size(),
+                                           BatchCoverage::kNone);
+  if (lon.size() == 0) {
+    return result;
+  }
+  // The NaN are skipped: a coordinate of the extent is NaN only if all the
+  // points have a NaN coordinate, and then no point is in a dataset.
+  auto extent = BBox(lon.minCoeff<Eigen::PropagateNumbers>(),
+                     lat.minCoeff<Eigen::PropagateNumbers>(),
+                     lon.maxCoeff<Eigen::PropagateNumbers>(),
+                     lat.maxCoeff<Eigen::PropagateNumbers>());
+  auto context = acquire_context(0);
+  for (size_t ix = 0; ix < result.size(); ++ix) {
+    auto &item = context->cache[ix];
+    const auto &transformer = select_transformer(item, espg_code);
+    if (!transformer.filter_bbox) {
+      result[ix] = BatchCoverage::kPartial;
+      continue;
+    }
+    const auto &bbox = item.dataset_info->bbox;
+    auto box = extent;
+    if (transformer.wrap_longitude) {
+      // Shift the extent with its western edge. If its eastern edge goes
+      // past the period, the wrapped longitudes span the whole period.
+      auto west = bbox.wrap_longitude(extent.min_x());
+      auto east = west + (extent.max_x() - extent.min_x());
+      if (!(east < bbox.min_x() + 360.0)) {
+        west = bbox.min_x();
+        east = bbox.min_x() + 360.0;
+      }
+      box = BBox(west, extent.min_y(), east, extent.max_y());
+    }
+    if (bbox.contains(box)) {
+      result[ix] = BatchCoverage::kFull;
+    } else if (bbox.intersects(box)) {
+      result[ix] = BatchCoverage::kPartial;
+    }
+  }
+  return result;
+}
+
+auto Dataset::decode_masks(const DatasetInfo &dataset_info,
+                           PackedMask &water, PackedMask *nodata_mask) const
+    -> void {
+  auto x_size = dataset_info.x_size;
+  auto y_size = dataset_info.y_size;
+  auto nodata = dataset_info.nodata;
+  auto path = std::string(dataset_info.dataset->GetDescription());
+  auto tiles_x = (x_size + tile_size_ - 1) / tile_size_;
+
+  // Each worker decodes bands of rows one tile high. The bands are packed
+  // into distinct words, the workers do not share any state.
+  auto worker = [&](size_t start, size_t end,
+                    const std::atomic<bool> &cancelled) {
+    auto band = std::vector<uint8_t>(x_size * tile_size_);
+    auto tile = std::vector<char>(dataset_info.tiff ? tile_size_ * tile_size_
+                                                    : 0);
+    // The GDAL datasets are not thread-safe: open a handle per worker, its
+    // blocks are released when it is closed.
+    auto dataset = GDALDatasetSmartPtr(
+        dataset_info.tiff ? nullptr
+                          : reinterpret_cast<GDALDataset *>(
+                                GDALOpen(path.c_str(), GA_ReadOnly)),
+        [](GDALDataset *ds) { GDALClose(ds); });
+    if (!dataset_info.tiff && !dataset) {
+      throw std::runtime_error("Failed to open the dataset: " + path);
+    }
+    for (auto ix = start; ix < end && !cancelled; ++ix) {
+      auto y_offset = ix * tile_size_;
+      auto rows = std::min(tile_size_, y_size - y_offset);
+      if (dataset_info.tiff) {
+        for (size_t tile_x = 0; tile_x < tiles_x; ++tile_x) {
+          dataset_info.tiff->read(tile_x, ix,
+                                  static_cast<uint8_t>(std::max(nodata, 0)),
+                                  tile.data());
+          auto x_offset = tile_x * tile_size_;
+          auto columns = std::min(tile_size_, x_size - x_offset);
+          for (size_t row = 0; row < rows; ++row) {
+            std::memcpy(band.data() + row * x_size + x_offset,
+                        tile.data() + row * tile_size_, columns);
+          }
+        }
+        direct_reads_.fetch_add(tiles_x, std::memory_order_relaxed);
+      } else if (dataset->GetRasterBand(1)->RasterIO(
+                     GF_Read, 0, static_cast<int>(y_offset),
+                     static_cast<int>(x_size), static_cast<int>(rows),
+                     band.data(), static_cast<int>(x_size),
+                     static_cast<int>(rows), GDT_Byte, 0, 0) != CE_None) {
+        throw std::runtime_error("Failed to read the raster to preload it.");
+      }
+      for (size_t row = 0; row < rows; ++row) {
+        water.set_row(y_offset + row, band.data() + row * x_size);
+        if (nodata_mask) {
+          nodata_mask->set_row(y_offset + row, band.data() + row * x_size,
+                               static_cast<uint8_t>(nodata));
+        }
+      }
+    }
+  };
+  parallel_for(worker, (y_size + tile_size_ - 1) / tile_size_, 0);
+}
+
+auto Dataset::preload_masks(DatasetInfo &dataset_info) const -> void {
+  auto nodata = dataset_info.nodata;
+  auto water =
+      std::make_unique<PackedMask>(dataset_info.x_size, dataset_info.y_size);
+  auto nodata_mask =
+      nodata >= 0 && nodata != 1
+          ? std::make_unique<PackedMask>(dataset_info.x_size,
+                                         dataset_info.y_size)
+          : nullptr;
+  decode_masks(dataset_info, *water, nodata_mask.get());
+  dataset_info.packed = std::move(water);
+  dataset_info.nodata_mask = std::move(nodata_mask);
+  dataset_info.preloaded = true;
+}
+
+auto Dataset::packed_mask(DatasetInfo &dataset_info) const
+    -> const PackedMask & {
+  if (!dataset_info.dataset) {
+    throw std::runtime_error(
+        "The quadtree backend does not support the count queries.");
+  }
+  // The raster is decoded with handles of its own: the queries keep using
+  // the dataset meanwhile.
+  std::lock_guard<std::mutex> lock(*dataset_info.packing);
+  if (!dataset_info.packed) {
+    auto water =
+        std::make_unique<PackedMask>(dataset_info.x_size, dataset_info.y_size);
+    decode_masks(dataset_info, *water, nullptr);
+    water->build_rank_index();
+    dataset_info.packed = std::move(water);
+  } else if (!dataset_info.packed->has_rank_index()) {
+    dataset_info.packed->build_rank_index();
+  }
+  return *dataset_info.packed;
+}
+
+auto Dataset::pixel_window(DatasetInfo &dataset_info, double min_lon,
+                           double min_lat, double max_lon,
+                           double max_lat) const
+    -> std::vector<std::array<size_t, 4>> {
+  auto result = std::vector<std::array<size_t, 4>>();
+  if (!(min_lon <= max_lon && min_lat <= max_lat)) {
+    return result;
+  }
+  // Split the box at the end of the 360 degrees following the western edge
+  // of a geographic dataset, as the points are wrapped in the queries. A box
+  // spanning the whole period covers all the columns.
+  const auto &bbox = dataset_info.bbox;
+  auto wrap = dataset_info.geographic && is_geographic(espg_code_);
+  auto full = wrap && max_lon - min_lon >= 360.0;
+  auto parts = std::vector<std::array<double, 2>>();
+  if (!wrap) {
+    parts.push_back({min_lon, max_lon});
+  } else if (full) {
+    parts.push_back({bbox.min_x(), bbox.min_x() + 360.0});
+  } else {
+    auto west = bbox.wrap_longitude(min_lon);
+    auto east = west + (max_lon - min_lon);
+    auto period_end = bbox.min_x() + 360.0;
+    parts.push_back({west, std::min(east, period_end)});
+    if (east > period_end) {
+      parts.push_back({bbox.min_x(), east - 360.0});
+    }
+  }
+
+  const auto &geotransform = dataset_info.geotransform;
+  auto x_size = static_cast<double>(dataset_info.x_size);
+  auto y_size = static_cast<double>(dataset_info.y_size);
+  auto period = 360.0 / geotransform[1];
+  for (const auto &[west, east] : parts) {
+    // The edges of a box are curved in another coordinate system: sample
+    // them, starting from the center of the box.
+    auto x = std::vector<double>{(west + east) / 2};
+    auto y = std::vector<double>{(min_lat + max_lat) / 2};
+    for (size_t ix = 0; ix <= kEdgeSamples; ++ix) {
+      auto ratio = static_cast<double>(ix) / kEdgeSamples;
+      auto lon = west + (east - west) * ratio;
+      auto lat = min_lat + (max_lat - min_lat) * ratio;
+      x.insert(x.end(), {lon, lon, west, east});
+      y.insert(y.end(), {min_lat, max_lat, lat, lat});
+    }
+    auto success = std::vector<int>(x.size());
+    {
+      // The transformation of the dataset is shared between the callers.
+      std::lock_guard<std::mutex> lock(*dataset_info.mutex);
+      dataset_info.transform->Transform(x.size(), x.data(), y.data(), nullptr,
+                                        success.data());
+    }
+
+    // Convert the samples to pixels. The columns of a geographic dataset
+    // are unwrapped around the first sample transformed, the transformation
+    // may have normalized the longitudes again.
+    auto px0 = std::numeric_limits<double>::infinity();
+    auto px1 = -px0;
+    auto py0 = px0;
+    auto py1 = -px0;
+    auto reference = std::optional<double>();
+    for (size_t ix = 0; ix < x.size(); ++ix) {
+      if (!success[ix]) {
+        continue;
+      }
+      auto column = (x[ix] - geotransform[0]) / geotransform[1];
+      auto row = (y[ix] - geotransform[3]) / geotransform[5];
+      if (wrap) {
+        if (!reference) {
+          reference = column - period * std::floor(column / period);
+        }
+        auto delta = column - *reference;
+        column = *reference + delta - period * std::round(delta / period);
+      }
+      px0 = std::min(px0, column);
+      px1 = std::max(px1, column);
+      py0 = std::min(py0, row);
+      py1 = std::max(py1, row);
+    }
+    // A box that cannot be transformed misses the dataset.
+    if (!(px0 <= px1 && py0 <= py1)) {
+      continue;
+    }
+    if (full) {
+      px0 = 0;
+      px1 = x_size;
+    }
+    auto x0 = static_cast<size_t>(std::floor(std::clamp(px0, 0.0, x_size)));
+    auto x1 = static_cast<size_t>(std::ceil(std::clamp(px1, 0.0, x_size)));
+    auto y0 = static_cast<size_t>(std::floor(std::clamp(py0, 0.0, y_size)));
+    auto y1 = static_cast<size_t>(std::ceil(std::clamp(py1, 0.0, y_size)));
+    if (x0 >= x1 || y0 >= y1) {
+      continue;
+    }
+    // The two parts of a box may meet once transformed: merge them.
+    if (!result.empty() && x0 < result[0][2] && result[0][0] < x1) {
+      auto &item = result[0];
+      item = {std::min(item[0], x0), std::min(item[1], y0),
+              std::max(item[2], x1), std::max(item[3], y1)};
+      continue;
+    }
+    result.push_back({x0, y0, x1, y1});
+  }
+  return result;
+}
+
+auto Dataset::count_water(double min_lon, double min_lat, double max_lon,
+                          double max_lat) const
+    -> std::tuple<uint64_t, uint64_t> {
+  auto windows =
+      std::vector<std::vector<std::array<size_t, 4>>>(base_datasets_.size());
+  auto candidates = std::vector<bool>(base_datasets_.size());
+  for (size_t ix = 0; ix < base_datasets_.size(); ++ix) {
+    windows[ix] = pixel_window(*base_datasets_[ix], min_lon, min_lat,
+                               max_lon, max_lat);
+    candidates[ix] = !windows[ix].empty();
+  }
+  int64_t water = 0;
+  int64_t total = 0;
+  for (size_t ix = 0; ix < base_datasets_.size(); ++ix) {
+    const auto &mask = packed_mask(*base_datasets_[ix]);
+    for (const auto &window : windows[ix]) {
+      const auto &[x0, y0, x1, y1] = window;
+      auto [extra_water, extra_total] =
+          count_overlaps(ix, window, candidates);
+      water += static_cast<int64_t>(mask.count(x0, y0, x1, y1)) + extra_water;
+      total += static_cast<int64_t>((x1 - x0) * (y1 - y0)) + extra_total;
+    }
+  }
+  return {static_cast<uint64_t>(water), static_cast<uint64_t>(total)};
+}
+
+auto Dataset::count_overlaps(size_t index, const std::array<size_t, 4> &window,
+                             const std::vector<bool> &candidates) const
+    -> std::tuple<int64_t, int64_t> {
+  auto &source = *base_datasets_[index];
+  const auto &mask = packed_mask(source);
+  const auto &[x0, y0, x1, y1] = window;
+  const auto &geotransform = source.geotransform;
+  auto period = 360.0 / geotransform[1];
+
+  // Rows and columns of the window that may lie in another dataset.
+  struct Overlap {
+    const DatasetInfo *target;
+    const PackedMask *mask;
+    // Transformation to the target, null if the datasets share a coordinate
+    // system.
+    OGRCoordinateTransformationSmartPtr transform;
+    bool previous;
+    size_t y0;
+    size_t y1;
+    std::vector<std::array<size_t, 2>> columns;
+  };
+  auto overlaps = std::vector<Overlap>();
+  for (size_t jx = 0; jx < base_datasets_.size(); ++jx) {
+    if (jx == index || !candidates[jx]) {
+      continue;
+    }
+    auto &target = *base_datasets_[jx];
+    auto same = same_coordinate_system(source.projection.c_str(),
+                                       target.projection.c_str());
+    auto inverse = OGRCoordinateTransformationSmartPtr(
+        nullptr, [](OGRCoordinateTransformation *) {});
+    auto overlap =
+        Overlap{&target,
+                &packed_mask(target),
+                OGRCoordinateTransformationSmartPtr(
+                    nullptr, [](OGRCoordinateTransformation *) {}),
+                jx < index,
+                0,
+                0,
+                {}};
+    if (!same) {
+      overlap.transform = create_coordinate_transformation(
+          source.projection.c_str(), target.projection.c_str());
+      inverse = create_coordinate_transformation(target.projection.c_str(),
+                                                 source.projection.c_str());
+      if (!overlap.transform || !inverse) {
+        continue;
+      }
+    }
+
+    // Sample the edges of the target and convert them to the pixels of the
+    // source, unwrapping the columns of a geographic source around the first
+    // sample.
+    const auto &target_geotransform = target.geotransform;
+    auto x = std::vector<double>();
+    auto y = std::vector<double>();
+    auto target_x = static_cast<double>(target.x_size);
+    auto target_y = static_cast<double>(target.y_size);
+    for (size_t ix = 0; ix <= kEdgeSamples; ++ix) {
+      auto ratio = static_cast<double>(ix) / kEdgeSamples;
+      for (auto [column, row] : {std::pair(target_x * ratio, 0.0),
+                                 std::pair(target_x * ratio, target_y),
+                                 std::pair(0.0, target_y * ratio),
+                                 std::pair(target_x, target_y * ratio)}) {
+        x.push_back(target_geotransform[0] + column * target_geotransform[1]);
+        y.push_back(target_geotransform[3] + row * target_geotransform[5]);
+      }
+    }
+    auto success = std::vector<int>(x.size(), 1);
+    if (inverse) {
+      inverse->Transform(x.size(), x.data(), y.data(), nullptr,
+                         success.data());
+    }
+    auto px0 = std::numeric_limits<double>::infinity();
+    auto px1 = -px0;
+    auto py0 = px0;
+    auto py1 = -px0;
+    auto reference = std::optional<double>();
+    for (size_t ix = 0; ix < x.size(); ++ix) {
+      if (!success[ix]) {
+        continue;
+      }
+      auto column = (x[ix] - geotransform[0]) / geotransform[1];
+      auto row = (y[ix] - geotransform[3]) / geotransform[5];
+      if (source.geographic) {
+        if (!reference) {
+          reference = column;
+        }
+        auto delta = column - *reference;
+        column = *reference + delta - period * std::round(delta / period);
+      }
+      px0 = std::min(px0, column);
+      px1 = std::max(px1, column);
+      py0 = std::min(py0, row);
+      py1 = std::max(py1, row);
+    }
+    if (!(px0 <= px1 && py0 <= py1)) {
+      continue;
+    }
+
+    // Keep a pixel of margin for the curved edges, then intersect with the
+    // window, once per period of a geographic source.
+    auto row0 = std::max(std::floor(py0) - 1, static_cast<double>(y0));
+    auto row1 = std::min(std::ceil(py1) + 1, static_cast<double>(y1));
+    if (!(row0 < row1)) {
+      continue;
+    }
+    overlap.y0 = static_cast<size_t>(row0);
+    overlap.y1 = static_cast<size_t>(row1);
+    auto shift = std::floor(px0 / period);
+    for (auto turn : {-1.0, 0.0, 1.0}) {
+      if (!source.geographic && turn != 0.0) {
+        continue;
+      }
+      auto offset = source.geographic ? (turn - shift) * period : 0.0;
+      auto column0 =
+          std::max(std::floor(px0 + offset) - 1, static_cast<double>(x0));
+      auto column1 =
+          std::min(std::ceil(px1 + offset) + 1, static_cast<double>(x1));
+      if (column0 < column1) {
+        overlap.columns.push_back(
+            {static_cast<size_t>(column0), static_cast<size_t>(column1)});
+      }
+    }
+    if (!overlap.columns.empty()) {
+      overlaps.push_back(std::move(overlap));
+    }
+  }
+
+  // Look up the center of the pixels of the rows in the overlapping
+  // datasets.
+  constexpr uint8_t kCovered = 1;
+  constexpr uint8_t kWater = 2;
+  auto flags = std::vector<uint8_t>(x1 - x0);
+  auto flagged = std::vector<size_t>();
+  auto x = std::vector<double>();
+  auto y = std::vector<double>();
+  auto success = std::vector<int>();
+  int64_t water = 0;
+  int64_t total = 0;
+  for (auto row = y0; row < y1; ++row) {
+    for (const auto &overlap : overlaps) {
+      if (row < overlap.y0 || row >= overlap.y1) {
+        continue;
+      }
+      const auto &target = *overlap.target;
+      const auto &target_geotransform = target.geotransform;
+      auto target_period = 360.0 / target_geotransform[1];
+      for (const auto &[column0, column1] : overlap.columns) {
+        auto size = column1 - column0;
+        x.resize(size);
+        y.resize(size);
+        success.assign(size, 1);
+        for (size_t ix = 0; ix < size; ++ix) {
+          x[ix] = geotransform[0] +
+                  (static_cast<double>(column0 + ix) + 0.5) * geotransform[1];
+          y[ix] = geotransform[3] +
+                  (static_cast<double>(row) + 0.5) * geotransform[5];
+        }
+        if (overlap.transform) {
+          overlap.transform->Transform(size, x.data(), y.data(), nullptr,
+                                       success.data());
+        }
+        for (size_t ix = 0; ix < size; ++ix) {
+          if (!success[ix]) {
+            continue;
+          }
+          auto column =
+              (x[ix] - target_geotransform[0]) / target_geotransform[1];
+          auto target_row =
+              (y[ix] - target_geotransform[3]) / target_geotransform[5];
+          if (target.geographic) {
+            column -= target_period * std::floor(column / target_period);
+          }
+          if (!(column >= 0 && column < static_cast<double>(target.x_size) &&
+                target_row >= 0 &&
+                target_row < static_cast<double>(target.y_size))) {
+            continue;
+          }
+          auto &flag = flags[column0 + ix - x0];
+          if (flag == 0) {
+            flagged.push_back(column0 + ix);
+          }
+          flag |= overlap.previous ? kCovered : 0;
+          flag |= overlap.mask->test(static_cast<size_t>(column),
+                                     static_cast<size_t>(target_row))
+                      ? kWater
+                      : 0;
+        }
+      }
+    }
+
+    // A pixel covered by a previous dataset is counted there, the others are
+    // water if any dataset covering them says so.
+    for (auto column : flagged) {
+      auto &flag = flags[column - x0];
+      auto is_water = mask.test(column, row);
+      if (flag & kCovered) {
+        --total;
+        water -= is_water ? 1 : 0;
+      } else if ((flag & kWater) && !is_water) {
+        ++water;
+      }
+      flag = 0;
+    }
+    flagged.clear();
+  }
+  return {water, total};
+}
+
+auto Dataset::warm(double min_lon, double min_lat, double max_lon,
+                   double max_lat, size_t max_bytes, bool background) const
+    -> std::shared_ptr<WarmProgress> {
+  auto tile_bytes = tile_size_ * tile_size_;
+  auto nodes = topology_.size();
+
+  // Every node holds its own copy of the tiles.
+  auto max_tiles = max_bytes == 0 ? std::numeric_limits<size_t>::max()
+                                  : max_bytes / tile_bytes / nodes;
+
+  // Select the tiles intersecting the box, row by row, as long as they fit
+  // in the budget and in the shared cache of the dataset.
+  auto tiles = std::vector<std::vector<TileKey>>(base_datasets_.size());
+  uint64_t count = 0;
+  for (size_t ix = 0; ix < base_datasets_.size() && count < max_tiles;
+       ++ix) {
+    auto &dataset_info = *base_datasets_[ix];
+    if (dataset_info.quadtree || dataset_info.preloaded) {
+      continue;
+    }
+    auto &keys = tiles[ix];
+    // The parts of a box split at the end of the period may share the
+    // tiles of a narrow dataset.
+    auto selected = std::set<TileKey>();
+    for (const auto &[x0, y0, x1, y1] :
+         pixel_window(dataset_info, min_lon, min_lat, max_lon, max_lat)) {
+      for (auto ty = y0 / tile_size_;
+           ty < (y1 + tile_size_ - 1) / tile_size_ && count < max_tiles &&
+           keys.size() < shared_cache_size_;
+           ++ty) {
+        for (auto tx = x0 / tile_size_;
+             tx < (x1 + tile_size_ - 1) / tile_size_ && count < max_tiles &&
+             keys.size() < shared_cache_size_;
+             ++tx) {
+          auto key = TileKey(static_cast<int>(tx), static_cast<int>(ty));
+          if (selected.insert(key).second) {
+            keys.push_back(key);
+            ++count;
+          }
+        }
+      }
+    }
+  }
+
+  auto progress = std::make_shared<WarmProgress>(count * nodes, tile_bytes);
+  auto job = [this, tiles = std::move(tiles), progress, background]() {
+    try {
+      load_tiles(tiles, *progress, background);
+      progress->finish();
+    } catch (const std::exception &e) {
+      progress->finish(e.what());
+    }
+  };
+  if (!background) {
+    job();
+    progress->wait();
+    return progress;
+  }
+
+  std::lock_guard<std::mutex> lock(*warm_mutex_);
+  // Release the threads of the warm-ups already over.
+  auto it = std::remove_if(warm_jobs_.begin(), warm_jobs_.end(),
+                           [](auto &item) {
+                             if (!item.first->done()) {
+                               return false;
+                             }
+                             item.second.join();
+                             return true;
+                           });
+  warm_jobs_.erase(it, warm_jobs_.end());
+  warm_jobs_.emplace_back(progress, std::thread(std::move(job)));
+  return progress;
+}
+
+auto Dataset::load_tiles(const std::vector<std::vector<TileKey>> &tiles,
+                         WarmProgress &progress, bool pin) const -> void {
+  auto nodes = topology_.size();
+  auto failed = std::atomic<bool>(false);
+  if (nodes == 1) {
+    load_node_tiles(tiles, progress, 0, pin, failed);
+    return;
+  }
+
+  // One loader per node, running on the node whose memory receives the
+  // tiles. The first error stops the other loaders.
+  auto exception = std::exception_ptr();
+  auto threads = std::vector<std::thread>();
+  threads.reserve(nodes);
+  for (size_t node = 0; node < nodes; ++node) {
+    threads.emplace_back([&, node]() {
+      try {
+        load_node_tiles(tiles, progress, node, true, failed);
+      } catch (...) {
+        if (!failed.exchange(true)) {
+          exception = std::current_exception();
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+auto Dataset::load_node_tiles(const std::vector<std::vector<TileKey>> &tiles,
+                              WarmProgress &progress, size_t node, bool pin,
+                              const std::atomic<bool> &failed) const -> void {
+  if (pin) {
+    topology_.pin_current_thread(node);
+  }
+  auto context = acquire_context(node);
+  auto &buffers = context->buffers;
+  auto &reads = buffers.reads;
+  auto &slots = buffers.slots;
+  for (size_t ix = 0; ix < tiles.size(); ++ix) {
+    auto &dataset_cache = context->cache[ix];
+    const auto &keys = tiles[ix];
+    for (size_t first = 0; first < keys.size(); first += kWarmBatchSize) {
+      if (progress.cancelled() || failed) {
+        return;
+      }
+      auto last = std::min(first + kWarmBatchSize, keys.size());
+      uint64_t skipped = 0;
+      reads.clear();
+      slots.clear();
+      for (auto jx = first; jx < last; ++jx) {
+        const auto &tile_key = keys[jx];
+        if (dataset_cache.shared_cache->is_tile_in_cache(tile_key)) {
+          ++skipped;
+          continue;
+        }
+        auto tile = find_disk_tile(*dataset_cache.dataset_info, tile_key);
+        if (tile) {
+          dataset_cache.shared_cache->add_tile_to_cache(tile_key,
+                                                        std::move(tile));
+          continue;
+        }
+        slots.emplace_back(dataset_cache.arena->allocate());
+        reads.push_back({static_cast<size_t>(std::get<0>(tile_key)),
+                         static_cast<size_t>(std::get<1>(tile_key)),
+                         slots.back().get()});
+      }
+      if (!reads.empty()) {
+        read_tiles(dataset_cache, buffers);
+      }
+      progress.skip(skipped);
+      progress.advance(last - first - skipped);
+    }
+  }
+}
+
+auto Dataset::cache_stats() const -> CacheStats {
+  auto result = CacheStats();
+  for (const auto &item : base_datasets_) {
+    if (item->quadtree) {
+      result.modes.emplace_back("quadtree");
+    } else if (item->preloaded) {
+      result.modes.emplace_back("preload");
+    } else if (item->tiff) {
+      result.modes.emplace_back("direct");
+    } else {
+      result.modes.emplace_back(item->drop_blocks ? "drop" : "keep");
+    }
+  }
+  result.direct_reads = direct_reads_.load(std::memory_order_relaxed);
+  result.gdal_reads = gdal_reads_.load(std::memory_order_relaxed);
+  result.dropped_blocks = dropped_blocks_.load(std::memory_order_relaxed);
+  result.shared_hits = shared_hits_.load(std::memory_order_relaxed);
+  result.batches = batches_.load(std::memory_order_relaxed);
+  result.coalesced_reads = coalesced_reads_.load(std::memory_order_relaxed);
+  result.disk_hits = disk_hits_.load(std::memory_order_relaxed);
+  result.disk_writes = disk_writes_.load(std::memory_order_relaxed);
+  result.prefetch_issued = prefetcher_ ? prefetcher_->issued() : 0;
+  result.prefetch_hits = prefetcher_ ? prefetcher_->hits() : 0;
+  result.prefetch_hit_ratio =
+      result.prefetch_issued == 0
+          ? 0.0
+          : static_cast<double>(result.prefetch_hits) /
+                static_cast<double>(result.prefetch_issued);
+  result.gdal_cache_used = GDALGetCacheUsed64();
+  return result;
+}
+
+auto Dataset::classify(size_t pixel_x, size_t pixel_y,
+                       DatsetCache &dataset_cache) const -> PointClass {
   auto *dataset_info = dataset_cache.dataset_info;
-  if (!dataset_info->transform->Transform(1, &x, &y)) {
-    throw std::runtime_error("Failed to transform coordinates.");
+
+  // Answer from the pyramid if the point lies in a uniform region.
+  if (dataset_info->pyramid) {
+    switch (dataset_info->pyramid->lookup(pixel_x, pixel_y)) {
+      case Coverage::kWater:
+        return PointClass::kWater;
+      case Coverage::kLand:
+        return PointClass::kLand;
+      case Coverage::kMixed:
+        break;
+    }
+  }
+
+  // The quadtree holds the whole mask in memory, no tile to load.
+  if (dataset_info->quadtree) {
+    return dataset_info->quadtree->is_water(pixel_x, pixel_y)
+               ? PointClass::kWater
+               : PointClass::kLand;
   }
 
-  const auto &geotransform = dataset_info->geotransform;
-  auto pixel_x = static_cast<size_t>((x - geotransform[0]) / geotransform[1]);
-  auto pixel_y = static_cast<size_t>((y - geotransform[3]) / geotransform[5]);
+  // The preloaded masks are read-only, no lock nor tile to load.
+  if (dataset_info->preloaded) {
+    if (dataset_info->packed->test(pixel_x, pixel_y)) {
+      return PointClass::kWater;
+    }
+    return dataset_info->nodata_mask &&
+                   dataset_info->nodata_mask->test(pixel_x, pixel_y)
+               ? PointClass::kNoData
+               : PointClass::kLand;
+  }
 
   // Calculate the tile indices
   auto tile_x = pixel_x / tile_size_;
@@ -134,55 +1779,178 @@ auto Dataset::is_water(double lon, double lat,
   }
 
   // Get the tile data
-  auto &tile_data = dataset_cache.tile_cache.get_tile_from_cache(tile_key);
+  const auto *tile_data =
+      dataset_cache.tile_cache.get_tile_from_cache(tile_key).get();
 
   // Calculate the pixel's position within the tile
   auto local_x = pixel_x % tile_size_;
   auto local_y = pixel_y % tile_size_;
 
   // Get the value in the tile
-  return tile_data[local_y * tile_size_ + local_x] == 1;
+  auto value = static_cast<uint8_t>(tile_data[local_y * tile_size_ + local_x]);
+  if (value == 1) {
+    return PointClass::kWater;
+  }
+  return value == dataset_info->nodata ? PointClass::kNoData
+                                       : PointClass::kLand;
 }
 
-auto Dataset::load_tile_cache(const TileKey &tile_key,
-                              DatsetCache &dataset_cache) const -> void {
-  auto &dataset_info = *dataset_cache.dataset_info;
-  auto &tile_cache = dataset_cache.tile_cache;
+auto Dataset::find_shared_tile(DatsetCache &dataset_cache,
+                               const TileKey &tile_key) const -> Tile {
+  auto prefetched = false;
+  auto tile = dataset_cache.shared_cache->find_tile(tile_key, &prefetched);
+  if (tile) {
+    shared_hits_.fetch_add(1, std::memory_order_relaxed);
+    if (prefetched) {
+      prefetcher_->record_hit();
+    }
+  }
+  return tile;
+}
+
+auto Dataset::read_ahead(DatsetCache &dataset_cache,
+                         std::span<const TileKey> misses,
+                         std::span<const TileKey> batch) const -> void {
+  const auto &dataset_info = *dataset_cache.dataset_info;
+
+  // Direction of travel, if the previous miss was a neighbour.
+  auto dx = 0;
+  auto dy = 0;
+  if (dataset_cache.last_miss) {
+    dx = std::get<0>(misses.front()) - std::get<0>(*dataset_cache.last_miss);
+    dy = std::get<1>(misses.front()) - std::get<1>(*dataset_cache.last_miss);
+    if (std::abs(dx) > 1 || std::abs(dy) > 1) {
+      dx = dy = 0;
+    }
+  }
+  dataset_cache.last_miss = misses.back();
 
-  // Load a tile from the dataset into the cache
+  // The neighbours, the ones ahead first.
+  auto neighbours = std::array<std::pair<int, int>, 8>{
+      {{-1, -1}, {0, -1}, {1, -1}, {-1, 0}, {1, 0}, {-1, 1}, {0, 1}, {1, 1}}};
+  std::stable_sort(neighbours.begin(), neighbours.end(),
+                   [&](const auto &lhs, const auto &rhs) {
+                     return lhs.first * dx + lhs.second * dy >
+                            rhs.first * dx + rhs.second * dy;
+                   });
+
+  auto tiles_x = static_cast<int>((dataset_info.x_size + tile_size_ - 1) /
+                                  tile_size_);
+  auto tiles_y = static_cast<int>((dataset_info.y_size + tile_size_ - 1) /
+                                  tile_size_);
+  // A single budget for the whole batch, spent on the tiles it will not read
+  // itself.
+  auto budget = prefetcher_->budget();
+  auto queued = std::vector<TileKey>();
+  for (const auto &[tile_x, tile_y] : misses) {
+    for (const auto &[offset_x, offset_y] : neighbours) {
+      if (queued.size() == budget) {
+        return;
+      }
+      auto x = tile_x + offset_x;
+      auto y = tile_y + offset_y;
+      if (x < 0 || y < 0 || x >= tiles_x || y >= tiles_y) {
+        continue;
+      }
+      auto key = TileKey(x, y);
+      if (std::binary_search(batch.begin(), batch.end(), key,
+                             row_major_less) ||
+          std::find(queued.begin(), queued.end(), key) != queued.end() ||
+          dataset_cache.shared_cache->is_tile_in_cache(key)) {
+        continue;
+      }
+      if (!prefetcher_->enqueue(
+              {dataset_cache.index, dataset_cache.node, key})) {
+        return;
+      }
+      queued.push_back(key);
+    }
+  }
+}
+
+auto Dataset::prefetch(const Prefetcher::Request &request) const -> void {
+  auto &dataset_info = *base_datasets_[request.dataset];
+  auto &shared_cache = *dataset_info.shared_caches[request.node];
+  if (shared_cache.is_tile_in_cache(request.key)) {
+    return;
+  }
+  auto tile = find_disk_tile(dataset_info, request.key);
+  if (!tile) {
+    tile = read_tile(dataset_info, *arenas_[request.node], request.key);
+  }
+  shared_cache.add_prefetched_tile(request.key, std::move(tile));
+}
+
+auto Dataset::find_disk_tile(const DatasetInfo &dataset_info,
+                             const TileKey &tile_key) const -> Tile {
+  if (!dataset_info.disk_cache) {
+    return nullptr;
+  }
+  auto tile = dataset_info.disk_cache->load(tile_key);
+  if (tile) {
+    disk_hits_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return tile;
+}
+
+auto Dataset::read_tile(DatasetInfo &dataset_info, TileArena &arena,
+                        const TileKey &tile_key) const -> Tile {
   auto x_offset = std::get<0>(tile_key) * tile_size_;
   auto y_offset = std::get<1>(tile_key) * tile_size_;
+
+  // The pixel coordinates are validated by locate, this is a safeguard.
+  if (x_offset >= dataset_info.x_size || y_offset >= dataset_info.y_size) {
+    throw std::runtime_error("Requested tile is out of bounds.");
+  }
+
   auto x_size = std::min(tile_size_, dataset_info.x_size - x_offset);
   auto y_size = std::min(tile_size_, dataset_info.y_size - y_offset);
 
-  auto tile_data = std::vector<char>(tile_size_ * tile_size_);
-
-  //   printf("x_offset: %d\n", x_offset);
-  //   printf("y_offset: %d\n", y_offset);
-  //   printf("x_size: %d\n", x_size);
-  //   printf("y_size: %d\n", y_size);
-  //   printf("dataset_info.x_size: %d\n", dataset_info.x_size);
-  //   printf("dataset_info.y_size: %d\n", dataset_info.y_size);
-  //   fflush(stdout);
+  // The slot is recycled from an evicted tile once the caches are full. It
+  // is taken from the arena of the node running the thread, which first
+  // touched it when the NUMA placement is enabled.
+  auto tile_data = arena.allocate();
 
-  if (x_offset >= dataset_info.x_size || y_offset >= dataset_info.y_size ||
-      x_offset + x_size > dataset_info.x_size ||
-      y_offset + y_size > dataset_info.y_size || x_offset < 0 || y_offset < 0) {
-    throw std::runtime_error("Requested tile is out of bounds.");
+  // Read the tile from the dataset. The direct reader is thread-safe,
+  // otherwise lock the mutex to prevent concurrent access to the dataset.
+  if (dataset_info.tiff) {
+    dataset_info.tiff->read(
+        std::get<0>(tile_key), std::get<1>(tile_key),
+        static_cast<uint8_t>(std::max(dataset_info.nodata, 0)),
+        tile_data.get());
+    direct_reads_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    std::lock_guard<std::mutex> lock(*dataset_info.mutex);
+    // The tiles on the right and bottom edges are partial: read them at
+    // full resolution into the top-left corner of the buffer.
+    read_window(dataset_info, x_offset, y_offset, x_size, y_size,
+                tile_data.get(), tile_size_);
+    gdal_reads_.fetch_add(1, std::memory_order_relaxed);
   }
+  if (dataset_info.disk_cache) {
+    if (dataset_info.disk_cache->store(tile_key, tile_data.get())) {
+      disk_writes_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  return Tile(std::move(tile_data));
+}
 
-  // Read the tile from the dataset. Lock the mutex to prevent concurrent
-  // access to the dataset.
-  {
-    std::lock_guard<std::mutex> lock(*dataset_info.mutex);
-    auto band = dataset_info.dataset->GetRasterBand(1);
-    if (band->RasterIO(GF_Read, x_offset, y_offset, x_size, y_size,
-                       tile_data.data(), tile_size_, tile_size_, GDT_Byte, 0,
-                       0) != CE_None) {
-      throw std::runtime_error("Failed to read tile from dataset.");
+auto Dataset::load_tile_cache(const TileKey &tile_key,
+                              DatsetCache &dataset_cache) const -> void {
+  // Another thread of the node may have loaded the tile already.
+  auto tile = find_shared_tile(dataset_cache, tile_key);
+  if (!tile) {
+    if (prefetcher_) {
+      read_ahead(dataset_cache, {&tile_key, 1}, {&tile_key, 1});
+    }
+    tile = find_disk_tile(*dataset_cache.dataset_info, tile_key);
+    if (!tile) {
+      tile = read_tile(*dataset_cache.dataset_info, *dataset_cache.arena,
+                       tile_key);
     }
+    dataset_cache.shared_cache->add_tile_to_cache(tile_key, tile);
   }
-  tile_cache.add_tile_to_cache(tile_key, std::move(tile_data));
+  dataset_cache.tile_cache.add_tile_to_cache(tile_key, std::move(tile));
 }
 
 }  // namespace hydrosheds
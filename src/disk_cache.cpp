@@ -0,0 +1,126 @@
+#include "hydrosheds/disk_cache.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <system_error>
+
+#include "hydrosheds/file_identity.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HYDROSHEDS_MMAP
+#endif
+
+namespace hydrosheds {
+
+auto DiskTileCache::open(const std::string &directory, const std::string &path,
+                         const std::vector<std::string> &files,
+                         const std::array<double, 6> &geotransform,
+                         size_t tile_size) -> std::unique_ptr<DiskTileCache> {
+#ifdef HYDROSHEDS_MMAP
+  // The name of the directory starts with a hash of the path, followed by a
+  // hash of the identity of the files of the dataset: a modified file, even
+  // one referenced by a VRT, gets a new directory.
+  auto hash = path_hash(path);
+  auto identity = raster_identity(files, geotransform);
+  if (!hash || !identity) {
+    return nullptr;
+  }
+  auto prefix = to_hex(*hash) + "-";
+  auto target =
+      std::filesystem::path(directory) /
+      (prefix + to_hex(fnv1a(&tile_size, sizeof(tile_size), *identity)));
+  auto error = std::error_code();
+  std::filesystem::create_directories(target, error);
+  if (error) {
+    return nullptr;
+  }
+
+  // Remove the tiles of the previous versions of the file.
+  for (const auto &entry :
+       std::filesystem::directory_iterator(directory, error)) {
+    auto stem = entry.path().filename().string();
+    if (stem.rfind(prefix, 0) == 0 && entry.path() != target) {
+      std::filesystem::remove_all(entry.path(), error);
+    }
+  }
+  return std::unique_ptr<DiskTileCache>(
+      new DiskTileCache(target, tile_size * tile_size));
+#else
+  return nullptr;
+#endif
+}
+
+auto DiskTileCache::tile_path(const TileKey &key) const
+    -> std::filesystem::path {
+  return directory_ / (std::to_string(std::get<0>(key)) + "_" +
+                       std::to_string(std::get<1>(key)) + ".tile");
+}
+
+auto DiskTileCache::load(const TileKey &key) const -> Tile {
+#ifdef HYDROSHEDS_MMAP
+  auto fd = ::open(tile_path(key).c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat status {};
+  // A file of the wrong size was truncated: read the tile again.
+  if (fstat(fd, &status) != 0 ||
+      static_cast<size_t>(status.st_size) != tile_bytes_) {
+    close(fd);
+    return nullptr;
+  }
+  auto *data = mmap(nullptr, tile_bytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+  return Tile(static_cast<const char *>(data),
+              [size = tile_bytes_](const char *pointer) {
+                munmap(const_cast<char *>(pointer), size);
+              });
+#else
+  return nullptr;
+#endif
+}
+
+auto DiskTileCache::store(const TileKey &key, const char *tile) const
+    -> bool {
+#ifdef HYDROSHEDS_MMAP
+  static std::atomic<uint64_t> counter{0};
+  auto target = tile_path(key);
+  auto temporary = target;
+  temporary += "." + std::to_string(getpid()) + "." +
+               std::to_string(counter.fetch_add(1)) + ".tmp";
+  auto fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                   0644);
+  if (fd < 0) {
+    return false;
+  }
+  auto written = size_t(0);
+  while (written < tile_bytes_) {
+    auto result = ::write(fd, tile + written, tile_bytes_ - written);
+    if (result <= 0) {
+      break;
+    }
+    written += static_cast<size_t>(result);
+  }
+  close(fd);
+  // The rename is atomic: the readers see the whole tile or nothing.
+  if (written != tile_bytes_ ||
+      std::rename(temporary.c_str(), target.c_str()) != 0) {
+    unlink(temporary.c_str());
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+}  // namespace hydrosheds
@@ -0,0 +1,283 @@
+#include "hydrosheds/distance_to_coast.hpp"
+
+#include <cpl_string.h>
+#include <gdal_priv.h>
+#include <ogr_spatialref.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hydrosheds/parallel_for.hpp"
+
+namespace hydrosheds {
+
+// Mean radius of the Earth, in meters.
+constexpr double kEarthRadius = 6371008.8;
+
+// Squared distance used for the pixels without feature.
+constexpr double kFar = 1e20;
+
+// Smallest cosine of the latitude used to compute the pixel width, to keep
+// the distance transform defined at the poles.
+constexpr double kMinCosine = 1e-6;
+
+// Largest halo read around a tile, in pixels. It bounds the memory used by a
+// worker when the pixels are too small for the halo to cover max_distance,
+// for example near the poles.
+constexpr size_t kMaxHalo = 4096;
+
+// Block size of the tiled GeoTIFF files.
+constexpr size_t kBlockAlignment = 16;
+
+using GDALDatasetPtr = std::unique_ptr<GDALDataset, void (*)(GDALDataset *)>;
+
+// Opens a GDAL dataset, closing it when the pointer is released.
+inline auto open_dataset(const std::string &path) -> GDALDatasetPtr {
+  auto dataset = GDALDatasetPtr(
+      reinterpret_cast<GDALDataset *>(GDALOpen(path.c_str(), GA_ReadOnly)),
+      [](GDALDataset *ds) { GDALClose(ds); });
+  if (!dataset) {
+    throw std::runtime_error("Failed to open GeoTIFF file: " + path);
+  }
+  return dataset;
+}
+
+// Reads the columns [x0, x0 + width) of the rows [y0, y0 + height) of a
+// band, the columns being taken modulo x_size.
+inline auto read_window(GDALRasterBand *band, ptrdiff_t x0, size_t y0,
+                        size_t width, size_t height, size_t x_size,
+                        uint8_t *buffer) -> bool {
+  auto period = static_cast<ptrdiff_t>(x_size);
+  size_t done = 0;
+  while (done < width) {
+    auto column = static_cast<size_t>(
+        ((x0 + static_cast<ptrdiff_t>(done)) % period + period) % period);
+    auto count = std::min(width - done, x_size - column);
+    if (band->RasterIO(GF_Read, static_cast<int>(column),
+                       static_cast<int>(y0), static_cast<int>(count),
+                       static_cast<int>(height), buffer + done,
+                       static_cast<int>(count), static_cast<int>(height),
+                       GDT_Byte, 1, static_cast<GSpacing>(width)) != CE_None) {
+      return false;
+    }
+    done += count;
+  }
+  return true;
+}
+
+// Squared Euclidean distance transform of a line of samples spaced by step
+// (Felzenszwalb & Huttenlocher). The scratch buffers must hold size + 1
+// elements.
+inline auto distance_transform(const double *f, double *d, size_t size,
+                               double step, std::vector<size_t> &v,
+                               std::vector<double> &z) -> void {
+  auto w2 = step * step;
+  auto parabola = [&](size_t q, size_t p) {
+    auto dq = static_cast<double>(q);
+    auto dp = static_cast<double>(p);
+    return ((f[q] + w2 * dq * dq) - (f[p] + w2 * dp * dp)) /
+           (2 * w2 * (dq - dp));
+  };
+  size_t k = 0;
+  v[0] = 0;
+  z[0] = -std::numeric_limits<double>::infinity();
+  z[1] = std::numeric_limits<double>::infinity();
+  for (size_t q = 1; q < size; ++q) {
+    auto s = parabola(q, v[k]);
+    while (s <= z[k]) {
+      --k;
+      s = parabola(q, v[k]);
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = std::numeric_limits<double>::infinity();
+  }
+  k = 0;
+  for (size_t q = 0; q < size; ++q) {
+    while (z[k + 1] < static_cast<double>(q)) {
+      ++k;
+    }
+    auto delta = static_cast<double>(q) - static_cast<double>(v[k]);
+    d[q] = w2 * delta * delta + f[v[k]];
+  }
+}
+
+auto build_distance_to_coast(const std::string &path,
+                             const std::string &output, double max_distance,
+                             size_t tile_size, size_t num_threads) -> void {
+  if (tile_size == 0 || tile_size % kBlockAlignment != 0) {
+    throw std::invalid_argument(
+        "tile_size must be a positive multiple of 16, the block size of the "
+        "GeoTIFF files: " +
+        std::to_string(tile_size));
+  }
+  GDALAllRegister();
+
+  auto source = open_dataset(path);
+  auto geotransform = std::array<double, 6>();
+  if (source->GetGeoTransform(geotransform.data()) != CE_None) {
+    throw std::runtime_error("Failed to get geotransform for file: " + path);
+  }
+  auto x_size = static_cast<size_t>(source->GetRasterXSize());
+  auto y_size = static_cast<size_t>(source->GetRasterYSize());
+
+  OGRSpatialReference srs;
+  const char *wkt = source->GetProjectionRef();
+  srs.importFromWkt(&wkt);
+  auto geographic = srs.IsGeographic() != 0;
+  // The halo of the tiles on the edges of a mask covering the 360 degrees of
+  // longitude wraps around to the other edge.
+  auto periodic =
+      geographic && std::abs(std::abs(geotransform[1]) * x_size - 360.0) <
+                        std::abs(geotransform[1]) / 2;
+
+  // Create the tiled and compressed output sharing the grid of the mask.
+  auto *driver = GetGDALDriverManager()->GetDriverByName("GTiff");
+  if (driver == nullptr) {
+    throw std::runtime_error("The GTiff driver is not available.");
+  }
+  auto block_size = std::to_string(tile_size);
+  char **options = nullptr;
+  options = CSLSetNameValue(options, "TILED", "YES");
+  options = CSLSetNameValue(options, "BLOCKXSIZE", block_size.c_str());
+  options = CSLSetNameValue(options, "BLOCKYSIZE", block_size.c_str());
+  options = CSLSetNameValue(options, "COMPRESS", "DEFLATE");
+  options = CSLSetNameValue(options, "PREDICTOR", "3");
+  options = CSLSetNameValue(options, "BIGTIFF", "IF_SAFER");
+  auto target = GDALDatasetPtr(
+      driver->Create(output.c_str(), static_cast<int>(x_size),
+                     static_cast<int>(y_size), 1, GDT_Float32, options),
+      [](GDALDataset *ds) { GDALClose(ds); });
+  CSLDestroy(options);
+  if (!target) {
+    throw std::runtime_error("Failed to create GeoTIFF file: " + output);
+  }
+  target->SetGeoTransform(geotransform.data());
+  target->SetProjection(source->GetProjectionRef());
+  source.reset();
+
+  // Size of the pixels, in meters for a geographic mask.
+  auto to_meters = geographic ? std::numbers::pi / 180 * kEarthRadius : 1.0;
+  auto pixel_height = std::abs(geotransform[5]) * to_meters;
+  auto pixel_width = [&](size_t row) {
+    if (!geographic) {
+      return std::abs(geotransform[1]);
+    }
+    auto lat = geotransform[3] + geotransform[5] * (row + 0.5);
+    return std::abs(geotransform[1]) * to_meters *
+           std::max(std::cos(lat * std::numbers::pi / 180), kMinCosine);
+  };
+
+  auto tiles_x = (x_size + tile_size - 1) / tile_size;
+  auto tiles_y = (y_size + tile_size - 1) / tile_size;
+  auto halo_y = std::min(
+      kMaxHalo, static_cast<size_t>(std::ceil(max_distance / pixel_height)));
+  auto write_mutex = std::mutex();
+
+  auto worker = [&](size_t start, size_t end,
+                    const std::atomic<bool> &cancelled) {
+    // Each worker reads the mask through its own handle.
+    auto dataset = open_dataset(path);
+    auto *band = dataset->GetRasterBand(1);
+    auto window = std::vector<uint8_t>();
+    auto columns = std::vector<double>();
+    auto line = std::vector<double>();
+    auto distances = std::vector<double>();
+    auto v = std::vector<size_t>();
+    auto z = std::vector<double>();
+    auto result = std::vector<float>();
+
+    for (auto ix = start; ix < end && !cancelled; ++ix) {
+      auto x_offset = (ix % tiles_x) * tile_size;
+      auto y_offset = (ix / tiles_x) * tile_size;
+      auto width = std::min(tile_size, x_size - x_offset);
+      auto height = std::min(tile_size, y_size - y_offset);
+
+      // The halo covers the pixels closer than max_distance to the tile. Its
+      // width is set by the row of the window closest to the pole.
+      auto wy0 = y_offset - std::min(y_offset, halo_y);
+      auto wy1 = std::min(y_size, y_offset + height + halo_y);
+      auto narrowest = std::min(pixel_width(wy0), pixel_width(wy1 - 1));
+      auto halo_x = std::min(
+          kMaxHalo, static_cast<size_t>(std::ceil(max_distance / narrowest)));
+      auto left = std::min(x_offset, halo_x);
+      auto right = std::min(x_size - x_offset - width, halo_x);
+      if (periodic) {
+        // A window covering the whole period is centered on the tile.
+        left = right = std::min(halo_x, (x_size - width) / 2);
+      }
+      auto wx0 =
+          static_cast<ptrdiff_t>(x_offset) - static_cast<ptrdiff_t>(left);
+      auto window_width = left + width + right;
+      auto window_height = wy1 - wy0;
+
+      window.resize(window_width * window_height);
+      if (!read_window(band, wx0, wy0, window_width, window_height, x_size,
+                       window.data())) {
+        throw std::runtime_error("Failed to read window from dataset: " +
+                                 path);
+      }
+
+      auto longest = std::max(window_width, window_height) + 1;
+      // Only the rows of the tile are kept after the vertical pass.
+      columns.resize(window_width * height);
+      line.resize(longest);
+      distances.resize(longest);
+      v.resize(longest);
+      z.resize(longest + 1);
+      result.assign(width * height, static_cast<float>(max_distance));
+
+      // One transform for the distance to water, one for the distance to
+      // land: each pixel keeps the distance to the other class.
+      for (auto water : {true, false}) {
+        // Vertical pass over the whole window.
+        for (size_t x = 0; x < window_width; ++x) {
+          for (size_t y = 0; y < window_height; ++y) {
+            line[y] = (window[y * window_width + x] == 1) == water ? 0 : kFar;
+          }
+          distance_transform(line.data(), distances.data(), window_height,
+                             pixel_height, v, z);
+          for (size_t row = 0; row < height; ++row) {
+            columns[row * window_width + x] = distances[y_offset + row - wy0];
+          }
+        }
+        // Horizontal pass over the rows of the tile only.
+        for (size_t row = 0; row < height; ++row) {
+          auto y = y_offset + row - wy0;
+          distance_transform(columns.data() + row * window_width,
+                             distances.data(), window_width,
+                             pixel_width(y_offset + row), v, z);
+          for (size_t col = 0; col < width; ++col) {
+            auto x = left + col;
+            if ((window[y * window_width + x] == 1) != water) {
+              result[row * width + col] = static_cast<float>(
+                  std::min(std::sqrt(distances[x]), max_distance));
+            }
+          }
+        }
+      }
+
+      std::lock_guard<std::mutex> lock(write_mutex);
+      if (target->GetRasterBand(1)->RasterIO(
+              GF_Write, static_cast<int>(x_offset), static_cast<int>(y_offset),
+              static_cast<int>(width), static_cast<int>(height), result.data(),
+              static_cast<int>(width), static_cast<int>(height), GDT_Float32, 0,
+              0) != CE_None) {
+        throw std::runtime_error("Failed to write tile to dataset: " + output);
+      }
+    }
+  };
+  parallel_for(worker, tiles_x * tiles_y, num_threads);
+}
+
+}  // namespace hydrosheds
@@ -0,0 +1,50 @@
+#include "hydrosheds/file_identity.hpp"
+
+#include <filesystem>
+#include <system_error>
+
+namespace hydrosheds {
+
+auto path_hash(const std::string &path) -> std::optional<uint64_t> {
+  auto error = std::error_code();
+  auto name =
+      std::filesystem::absolute(path, error).lexically_normal().string();
+  if (error) {
+    return std::nullopt;
+  }
+  return fnv1a(name.data(), name.size());
+}
+
+auto raster_identity(const std::vector<std::string> &files,
+                     const std::array<double, 6> &geotransform)
+    -> std::optional<uint64_t> {
+  if (files.empty()) {
+    return std::nullopt;
+  }
+  auto identity = kFnvSeed;
+  for (const auto &file : files) {
+    auto error = std::error_code();
+    auto source = std::filesystem::absolute(file, error).lexically_normal();
+    if (error) {
+      return std::nullopt;
+    }
+    auto size = std::filesystem::file_size(source, error);
+    if (error) {
+      return std::nullopt;
+    }
+    auto mtime = std::filesystem::last_write_time(source, error)
+                     .time_since_epoch()
+                     .count();
+    if (error) {
+      return std::nullopt;
+    }
+    auto name = source.string();
+    identity = fnv1a(name.data(), name.size(), identity);
+    identity = fnv1a(&size, sizeof(size), identity);
+    identity = fnv1a(&mtime, sizeof(mtime), identity);
+  }
+  return fnv1a(geotransform.data(), sizeof(double) * geotransform.size(),
+               identity);
+}
+
+}  // namespace hydrosheds
@@ -3,20 +3,210 @@
 #include <pybind11/stl.h>
 
 #include "hydrosheds/dataset.hpp"
+#include "hydrosheds/distance_to_coast.hpp"
+#include "hydrosheds/parallel_for.hpp"
+#include "hydrosheds/raster_stack.hpp"
 
 PYBIND11_MODULE(hydrosheds, m) {
+  // Stop the parallel loops when the user presses Ctrl+C: the signal is
+  // raised as KeyboardInterrupt once the workers are cancelled.
+  hydrosheds::set_interrupt_handler([] {
+    pybind11::gil_scoped_acquire acquire;
+    if (PyErr_CheckSignals() != 0) {
+      throw pybind11::error_already_set();
+    }
+  });
+
+  pybind11::enum_<hydrosheds::BlockCacheMode>(m, "BlockCache")
+      .value("AUTO", hydrosheds::BlockCacheMode::kAuto)
+      .value("KEEP", hydrosheds::BlockCacheMode::kKeep)
+      .value("DROP", hydrosheds::BlockCacheMode::kDrop);
+
+  pybind11::enum_<hydrosheds::OutputMode>(m, "Output")
+      .value("BOOL", hydrosheds::OutputMode::kBool)
+      .value("PACKED", hydrosheds::OutputMode::kPacked)
+      .value("INDICES", hydrosheds::OutputMode::kIndices)
+      .value("COUNT", hydrosheds::OutputMode::kCount);
+
+  pybind11::class_<hydrosheds::CacheStats>(m, "CacheStats")
+      .def_readonly("modes", &hydrosheds::CacheStats::modes)
+      .def_readonly("direct_reads", &hydrosheds::CacheStats::direct_reads)
+      .def_readonly("gdal_reads", &hydrosheds::CacheStats::gdal_reads)
+      .def_readonly("dropped_blocks", &hydrosheds::CacheStats::dropped_blocks)
+      .def_readonly("shared_hits", &hydrosheds::CacheStats::shared_hits)
+      .def_readonly("batches", &hydrosheds::CacheStats::batches)
+      .def_readonly("coalesced_reads",
+                    &hydrosheds::CacheStats::coalesced_reads)
+      .def_readonly("disk_hits", &hydrosheds::CacheStats::disk_hits)
+      .def_readonly("disk_writes", &hydrosheds::CacheStats::disk_writes)
+      .def_readonly("prefetch_issued",
+                    &hydrosheds::CacheStats::prefetch_issued)
+      .def_readonly("prefetch_hits", &hydrosheds::CacheStats::prefetch_hits)
+      .def_readonly("prefetch_hit_ratio",
+                    &hydrosheds::CacheStats::prefetch_hit_ratio)
+      .def_readonly("gdal_cache_used",
+                    &hydrosheds::CacheStats::gdal_cache_used);
+
+  pybind11::class_<hydrosheds::WarmProgress,
+                   std::shared_ptr<hydrosheds::WarmProgress>>(m,
+                                                              "WarmProgress")
+      .def_property_readonly("total_tiles",
+                             &hydrosheds::WarmProgress::total_tiles)
+      .def_property_readonly("loaded_tiles",
+                             &hydrosheds::WarmProgress::loaded_tiles)
+      .def_property_readonly("skipped_tiles",
+                             &hydrosheds::WarmProgress::skipped_tiles)
+      .def_property_readonly("loaded_bytes",
+                             &hydrosheds::WarmProgress::loaded_bytes)
+      .def_property_readonly("fraction", &hydrosheds::WarmProgress::fraction)
+      .def_property_readonly("done", &hydrosheds::WarmProgress::done)
+      .def("cancel", &hydrosheds::WarmProgress::cancel)
+      .def("wait", &hydrosheds::WarmProgress::wait,
+           pybind11::call_guard<pybind11::gil_scoped_release>());
+
+  pybind11::class_<hydrosheds::PreparedPoints>(m, "PreparedPoints")
+      .def_property_readonly("size", &hydrosheds::PreparedPoints::size)
+      .def_property_readonly("addresses",
+                             &hydrosheds::PreparedPoints::addresses)
+      .def("__len__", &hydrosheds::PreparedPoints::size);
+
   pybind11::class_<hydrosheds::Dataset>(m, "Dataset")
       .def(pybind11::init<const std::vector<std::string> &, int, size_t,
-                          size_t>(),
+                          size_t, const std::optional<std::string> &, bool,
+                          hydrosheds::BlockCacheMode, bool, bool,
+                          const std::optional<std::string> &, double>(),
            pybind11::arg("paths"), pybind11::arg("espg_code") = 4326,
            pybind11::arg("tile_size") = 256,
-           pybind11::arg("max_cache_size") = 4096)
+           pybind11::arg("max_cache_size") = 4096,
+           pybind11::arg("pyramid") = std::nullopt,
+           pybind11::arg("numa") = false,
+           pybind11::arg("block_cache") = hydrosheds::BlockCacheMode::kAuto,
+           pybind11::arg("readahead") = false,
+           pybind11::arg("preload") = false,
+           pybind11::arg("disk_cache") = std::nullopt,
+           pybind11::arg("max_transform_error") = 0.0)
       .def(
           "is_water",
           [](hydrosheds::Dataset &hs, hydrosheds::ConstRefVectorFloat64 lon,
-             hydrosheds::ConstRefVectorFloat64 lat,
-             size_t num_threads) { return hs.is_water(lon, lat, num_threads); },
+             hydrosheds::ConstRefVectorFloat64 lat, size_t num_threads,
+             bool fill_value, std::optional<int> epsg,
+             hydrosheds::OutputMode output) -> pybind11::object {
+            // The GIL is released during the query only: the result is
+            // converted to a Python object with the GIL held.
+            auto query = [](auto function) {
+              auto result = [&] {
+                pybind11::gil_scoped_release release;
+                return function();
+              }();
+              return pybind11::cast(std::move(result));
+            };
+            switch (output) {
+              case hydrosheds::OutputMode::kPacked:
+                return query([&] {
+                  return hs.is_water_packed(lon, lat, num_threads, fill_value,
+                                            epsg);
+                });
+              case hydrosheds::OutputMode::kIndices:
+                return query([&] {
+                  return hs.water_indices(lon, lat, num_threads, fill_value,
+                                          epsg);
+                });
+              case hydrosheds::OutputMode::kCount:
+                return query([&] {
+                  return hs.count_water_points(lon, lat, num_threads,
+                                               fill_value, epsg);
+                });
+              default:
+                return query([&] {
+                  return hs.is_water(lon, lat, num_threads, fill_value, epsg);
+                });
+            }
+          },
+          pybind11::arg("lon"), pybind11::arg("lat"),
+          pybind11::arg("num_threads") = 0, pybind11::arg("fill_value") = false,
+          pybind11::arg("epsg") = std::nullopt,
+          pybind11::arg("output") = hydrosheds::OutputMode::kBool)
+      .def(
+          "is_water",
+          [](hydrosheds::Dataset &hs,
+             const hydrosheds::PreparedPoints &points, size_t num_threads,
+             bool fill_value) {
+            return hs.is_water(points, num_threads, fill_value);
+          },
+          pybind11::arg("points"), pybind11::arg("num_threads") = 0,
+          pybind11::arg("fill_value") = false,
+          pybind11::call_guard<pybind11::gil_scoped_release>())
+      .def(
+          "classify",
+          [](hydrosheds::Dataset &hs, hydrosheds::ConstRefVectorFloat64 lon,
+             hydrosheds::ConstRefVectorFloat64 lat, size_t num_threads,
+             std::optional<int> epsg) {
+            return hs.classify(lon, lat, num_threads, epsg);
+          },
+          pybind11::arg("lon"), pybind11::arg("lat"),
+          pybind11::arg("num_threads") = 0,
+          pybind11::arg("epsg") = std::nullopt,
+          pybind11::call_guard<pybind11::gil_scoped_release>())
+      .def(
+          "classify",
+          [](hydrosheds::Dataset &hs,
+             const hydrosheds::PreparedPoints &points, size_t num_threads) {
+            return hs.classify(points, num_threads);
+          },
+          pybind11::arg("points"), pybind11::arg("num_threads") = 0,
+          pybind11::call_guard<pybind11::gil_scoped_release>())
+      .def(
+          "prepare",
+          [](hydrosheds::Dataset &hs, hydrosheds::ConstRefVectorFloat64 lon,
+             hydrosheds::ConstRefVectorFloat64 lat, size_t num_threads,
+             std::optional<int> epsg) {
+            return hs.prepare(lon, lat, num_threads, epsg);
+          },
           pybind11::arg("lon"), pybind11::arg("lat"),
           pybind11::arg("num_threads") = 0,
-          pybind11::call_guard<pybind11::gil_scoped_release>());
+          pybind11::arg("epsg") = std::nullopt,
+          pybind11::call_guard<pybind11::gil_scoped_release>())
+      .def("count_water", &hydrosheds::Dataset::count_water,
+           pybind11::arg("min_lon"), pybind11::arg("min_lat"),
+           pybind11::arg("max_lon"), pybind11::arg("max_lat"),
+           pybind11::call_guard<pybind11::gil_scoped_release>())
+      .def(
+          "warm",
+          [](const hydrosheds::Dataset &self,
+             const std::tuple<double, double, double, double> &bbox,
+             size_t max_bytes, bool background) {
+            auto [min_lon, min_lat, max_lon, max_lat] = bbox;
+            return self.warm(min_lon, min_lat, max_lon, max_lat, max_bytes,
+                             background);
+          },
+          pybind11::arg("bbox"), pybind11::arg("max_bytes") = 0,
+          pybind11::arg("background") = true,
+          pybind11::call_guard<pybind11::gil_scoped_release>())
+      .def("cache_stats", &hydrosheds::Dataset::cache_stats);
+
+  pybind11::class_<hydrosheds::RasterStack>(m, "RasterStack")
+      .def(pybind11::init<const std::vector<std::string> &, int, size_t,
+                          size_t>(),
+           pybind11::arg("paths"), pybind11::arg("espg_code") = 4326,
+           pybind11::arg("tile_size") = 256,
+           pybind11::arg("max_cache_size") = 4096)
+      .def("__len__", &hydrosheds::RasterStack::size)
+      .def("sample", &hydrosheds::RasterStack::sample, pybind11::arg("lon"),
+           pybind11::arg("lat"), pybind11::arg("num_threads") = 0,
+           pybind11::call_guard<pybind11::gil_scoped_release>());
+
+  m.attr("LAND") = static_cast<int>(hydrosheds::PointClass::kLand);
+  m.attr("WATER") = static_cast<int>(hydrosheds::PointClass::kWater);
+  m.attr("NODATA") = static_cast<int>(hydrosheds::PointClass::kNoData);
+  m.attr("OUTSIDE") = static_cast<int>(hydrosheds::PointClass::kOutside);
+
+  m.def("build_quadtree", &hydrosheds::build_quadtree, pybind11::arg("path"),
+        pybind11::arg("output"),
+        pybind11::call_guard<pybind11::gil_scoped_release>());
+
+  m.def("build_distance_to_coast", &hydrosheds::build_distance_to_coast,
+        pybind11::arg("path"), pybind11::arg("output"),
+        pybind11::arg("max_distance") = 50000.0,
+        pybind11::arg("tile_size") = 256, pybind11::arg("num_threads") = 0,
+        pybind11::call_guard<pybind11::gil_scoped_release>());
 }
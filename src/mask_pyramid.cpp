@@ -0,0 +1,138 @@
+#include "hydrosheds/mask_pyramid.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace hydrosheds {
+
+// Marker used while building the pyramid for cells not yet visited.
+constexpr uint8_t kUnset = 0xFF;
+
+// Signature written at the beginning of the pyramid files.
+constexpr std::array<char, 8> kMagic = {'H', 'S', 'P', 'Y', 'R', 'A', 'M', 3};
+
+// Merges the coverage of a pixel or a sub-cell into a cell.
+inline auto merge(uint8_t &cell, uint8_t value) noexcept -> void {
+  if (cell == kUnset) {
+    cell = value;
+  } else if (cell != value) {
+    cell = static_cast<uint8_t>(Coverage::kMixed);
+  }
+}
+
+MaskPyramid::MaskPyramid(size_t x_size, size_t y_size)
+    : x_size_(x_size), y_size_(y_size) {
+  for (size_t ix = 0; ix < kFactors.size(); ++ix) {
+    auto &level = levels_[ix];
+    level.factor = kFactors[ix];
+    level.x_size = (x_size + level.factor - 1) / level.factor;
+    level.y_size = (y_size + level.factor - 1) / level.factor;
+    level.cells.assign(level.x_size * level.y_size, kUnset);
+  }
+}
+
+auto MaskPyramid::build(GDALRasterBand *band, size_t x_size, size_t y_size,
+                        int nodata) -> MaskPyramid {
+  auto result = MaskPyramid(x_size, y_size);
+
+  // Coverage of a pixel according to its value.
+  auto coverage = std::array<uint8_t, 256>();
+  coverage.fill(static_cast<uint8_t>(Coverage::kLand));
+  coverage[1] = static_cast<uint8_t>(Coverage::kWater);
+  if (nodata >= 0 && nodata < 256) {
+    coverage[nodata] = static_cast<uint8_t>(Coverage::kMixed);
+  }
+
+  auto &finest = result.levels_[0];
+  auto buffer = std::vector<uint8_t>(x_size * finest.factor);
+
+  // Read the raster one row of cells at a time.
+  for (size_t cell_y = 0; cell_y < finest.y_size; ++cell_y) {
+    auto y_offset = cell_y * finest.factor;
+    auto rows = std::min(finest.factor, y_size - y_offset);
+    if (band->RasterIO(GF_Read, 0, static_cast<int>(y_offset),
+                       static_cast<int>(x_size), static_cast<int>(rows),
+                       buffer.data(), static_cast<int>(x_size),
+                       static_cast<int>(rows), GDT_Byte, 0, 0) != CE_None) {
+      throw std::runtime_error("Failed to read the raster to build the "
+                               "pyramid.");
+    }
+    auto *cells = finest.cells.data() + cell_y * finest.x_size;
+    for (size_t row = 0; row < rows; ++row) {
+      const auto *pixels = buffer.data() + row * x_size;
+      for (size_t x = 0; x < x_size; ++x) {
+        merge(cells[x / finest.factor], coverage[pixels[x]]);
+      }
+    }
+  }
+  result.reduce();
+  return result;
+}
+
+auto MaskPyramid::reduce() -> void {
+  for (size_t ix = 1; ix < levels_.size(); ++ix) {
+    const auto &fine = levels_[ix - 1];
+    auto &coarse = levels_[ix];
+    auto ratio = coarse.factor / fine.factor;
+    for (size_t y = 0; y < fine.y_size; ++y) {
+      for (size_t x = 0; x < fine.x_size; ++x) {
+        merge(coarse.cells[(y / ratio) * coarse.x_size + x / ratio],
+              fine.cells[y * fine.x_size + x]);
+      }
+    }
+  }
+}
+
+auto MaskPyramid::load(const std::string &path, size_t x_size,
+                       size_t y_size, uint64_t identity) -> MaskPyramid {
+  auto stream = std::ifstream(path, std::ios::binary);
+  if (!stream) {
+    throw std::runtime_error("Failed to open pyramid file: " + path);
+  }
+  auto magic = std::array<char, 8>();
+  uint64_t stored_x_size = 0;
+  uint64_t stored_y_size = 0;
+  uint64_t stored = 0;
+  stream.read(magic.data(), magic.size());
+  stream.read(reinterpret_cast<char *>(&stored_x_size), sizeof(stored_x_size));
+  stream.read(reinterpret_cast<char *>(&stored_y_size), sizeof(stored_y_size));
+  stream.read(reinterpret_cast<char *>(&stored), sizeof(stored));
+  if (!stream || magic != kMagic) {
+    throw std::runtime_error("Invalid pyramid file: " + path);
+  }
+  // The levels are sized from the raster, never from the header.
+  if (stored_x_size != x_size || stored_y_size != y_size ||
+      stored != identity) {
+    throw std::runtime_error("Stale pyramid file: " + path);
+  }
+  auto result = MaskPyramid(x_size, y_size);
+  for (auto &level : result.levels_) {
+    stream.read(reinterpret_cast<char *>(level.cells.data()),
+                static_cast<std::streamsize>(level.cells.size()));
+  }
+  if (!stream) {
+    throw std::runtime_error("Truncated pyramid file: " + path);
+  }
+  return result;
+}
+
+auto MaskPyramid::save(const std::string &path, uint64_t identity) const
+    -> void {
+  auto stream = std::ofstream(path, std::ios::binary | std::ios::trunc);
+  auto x_size = static_cast<uint64_t>(x_size_);
+  auto y_size = static_cast<uint64_t>(y_size_);
+  stream.write(kMagic.data(), kMagic.size());
+  stream.write(reinterpret_cast<const char *>(&x_size), sizeof(x_size));
+  stream.write(reinterpret_cast<const char *>(&y_size), sizeof(y_size));
+  stream.write(reinterpret_cast<const char *>(&identity), sizeof(identity));
+  for (const auto &level : levels_) {
+    stream.write(reinterpret_cast<const char *>(level.cells.data()),
+                 static_cast<std::streamsize>(level.cells.size()));
+  }
+  if (!stream) {
+    throw std::runtime_error("Failed to write pyramid file: " + path);
+  }
+}
+
+}  // namespace hydrosheds
@@ -0,0 +1,95 @@
+#include "hydrosheds/numa.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace hydrosheds {
+
+// Parses a list of CPUs formatted as "0-3,8,10-11".
+inline auto parse_cpu_list(const std::string &text) -> std::vector<int> {
+  auto result = std::vector<int>();
+  auto stream = std::istringstream(text);
+  auto item = std::string();
+  while (std::getline(stream, item, ',')) {
+    if (item.empty() || item == "\n") {
+      continue;
+    }
+    auto dash = item.find('-');
+    auto first = std::stoi(item.substr(0, dash));
+    auto last = dash == std::string::npos ? first
+                                          : std::stoi(item.substr(dash + 1));
+    for (auto cpu = first; cpu <= last; ++cpu) {
+      result.push_back(cpu);
+    }
+  }
+  return result;
+}
+
+auto NumaTopology::detect() -> NumaTopology {
+  auto result = NumaTopology();
+#ifdef __linux__
+  result.nodes_.clear();
+  auto root = std::filesystem::path("/sys/devices/system/node");
+  // The online nodes may be numbered with gaps. Without the list, fall back
+  // to the node directories.
+  auto ids = std::vector<int>();
+  auto online = std::ifstream(root / "online");
+  auto text = std::string();
+  if (online && std::getline(online, text)) {
+    ids = parse_cpu_list(text);
+  } else {
+    auto error = std::error_code();
+    for (const auto &entry : std::filesystem::directory_iterator(root, error)) {
+      auto name = entry.path().filename().string();
+      if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+          name.find_first_not_of("0123456789", 4) == std::string::npos) {
+        ids.push_back(std::stoi(name.substr(4)));
+      }
+    }
+    std::sort(ids.begin(), ids.end());
+  }
+  for (auto id : ids) {
+    auto stream =
+        std::ifstream(root / ("node" + std::to_string(id)) / "cpulist");
+    if (!stream) {
+      continue;
+    }
+    text.clear();
+    std::getline(stream, text);
+    // The nodes without CPUs, holding only memory, cannot run the workers.
+    auto cpus = parse_cpu_list(text);
+    if (!cpus.empty()) {
+      result.nodes_.push_back(std::move(cpus));
+    }
+  }
+#endif
+  if (result.nodes_.empty()) {
+    result.nodes_.emplace_back();
+  }
+  return result;
+}
+
+auto NumaTopology::pin_current_thread(size_t node) const -> void {
+#ifdef __linux__
+  const auto &cpus = nodes_[node];
+  if (cpus.empty()) {
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus) {
+    CPU_SET(cpu, &set);
+  }
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+}  // namespace hydrosheds
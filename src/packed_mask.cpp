@@ -0,0 +1,79 @@
+#include "hydrosheds/packed_mask.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace hydrosheds {
+
+// Number of rows read from the raster at once while packing.
+constexpr size_t kRowsPerRead = 256;
+
+auto PackedMask::build(GDALRasterBand *band, size_t x_size, size_t y_size,
+                       bool rank_index) -> PackedMask {
+  auto result = PackedMask(x_size, y_size);
+  auto buffer = std::vector<uint8_t>(x_size * kRowsPerRead);
+  for (size_t y_offset = 0; y_offset < y_size; y_offset += kRowsPerRead) {
+    auto rows = std::min(kRowsPerRead, y_size - y_offset);
+    if (band->RasterIO(GF_Read, 0, static_cast<int>(y_offset),
+                       static_cast<int>(x_size), static_cast<int>(rows),
+                       buffer.data(), static_cast<int>(x_size),
+                       static_cast<int>(rows), GDT_Byte, 0, 0) != CE_None) {
+      throw std::runtime_error("Failed to read the raster to pack the mask.");
+    }
+    for (size_t row = 0; row < rows; ++row) {
+      result.set_row(y_offset + row, buffer.data() + row * x_size);
+    }
+  }
+  if (rank_index) {
+    result.build_rank_index();
+  }
+  return result;
+}
+
+auto PackedMask::set_row(size_t y, const uint8_t *pixels,
+                         uint8_t value) noexcept -> void {
+  auto *row = words_.data() + y * words_per_row_;
+  for (size_t ix = 0; ix < words_per_row_; ++ix) {
+    auto first = ix * 64;
+    auto last = std::min(first + 64, x_size_);
+    uint64_t word = 0;
+    for (auto x = first; x < last; ++x) {
+      word |= static_cast<uint64_t>(pixels[x] == value) << (x - first);
+    }
+    row[ix] = word;
+  }
+}
+
+auto PackedMask::build_rank_index() -> void {
+  // One extra superblock per row so that the rank of the end of the row can
+  // be read without a special case.
+  superblocks_per_row_ = words_per_row_ / kWordsPerSuperblock + 1;
+  superblocks_.assign(superblocks_per_row_ * y_size_, 0);
+  for (size_t y = 0; y < y_size_; ++y) {
+    const auto *row = words_.data() + y * words_per_row_;
+    auto *superblocks = superblocks_.data() + y * superblocks_per_row_;
+    uint32_t total = 0;
+    for (size_t ix = 0; ix < words_per_row_; ++ix) {
+      if (ix % kWordsPerSuperblock == 0) {
+        superblocks[ix / kWordsPerSuperblock] = total;
+      }
+      total += static_cast<uint32_t>(std::popcount(row[ix]));
+    }
+    for (auto ix = (words_per_row_ + kWordsPerSuperblock - 1) /
+                   kWordsPerSuperblock;
+         ix < superblocks_per_row_; ++ix) {
+      superblocks[ix] = total;
+    }
+  }
+}
+
+auto PackedMask::count(size_t x0, size_t y0, size_t x1,
+                       size_t y1) const noexcept -> size_t {
+  size_t result = 0;
+  for (auto y = y0; y < y1; ++y) {
+    result += count(y, x0, x1);
+  }
+  return result;
+}
+
+}  // namespace hydrosheds
@@ -0,0 +1,100 @@
+#include "hydrosheds/prefetcher.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+namespace hydrosheds {
+
+Prefetcher::Prefetcher(std::function<void(const Request &)> load)
+    : load_(std::move(load)), thread_([this] { run(); }) {}
+
+Prefetcher::~Prefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+auto Prefetcher::budget() const -> size_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (recent_issued_ < kWarmup) {
+    return kMaxBudget;
+  }
+  auto ratio = static_cast<double>(recent_hits_) /
+               static_cast<double>(recent_issued_);
+  return std::clamp<size_t>(
+      static_cast<size_t>(std::ceil(ratio * kMaxBudget)), 1, kMaxBudget);
+}
+
+auto Prefetcher::enqueue(const Request &request) -> bool {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto key = std::make_tuple(request.dataset, request.node, request.key);
+    if (pending_.count(key) != 0) {
+      return true;
+    }
+    if (queue_.size() >= kMaxQueue) {
+      return false;
+    }
+    pending_.insert(key);
+    queue_.push_back(request);
+    ++issued_;
+    // Forget the old requests, so that the budget follows the workload.
+    if (++recent_issued_ >= kWindow) {
+      recent_issued_ /= 2;
+      recent_hits_ /= 2;
+    }
+  }
+  wake_.notify_one();
+  return true;
+}
+
+auto Prefetcher::record_hit() -> void {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++hits_;
+  recent_hits_ = std::min(recent_hits_ + 1, recent_issued_);
+}
+
+auto Prefetcher::issued() const -> uint64_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return issued_;
+}
+
+auto Prefetcher::hits() const -> uint64_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+auto Prefetcher::run() -> void {
+#ifdef __linux__
+  // On Linux, the nice value applies to the calling thread only: leave the
+  // CPU to the threads answering the queries.
+  setpriority(PRIO_PROCESS, 0, 19);
+#endif
+  auto lock = std::unique_lock<std::mutex>(mutex_);
+  while (true) {
+    wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+    if (stop_) {
+      return;
+    }
+    auto request = queue_.front();
+    queue_.pop_front();
+    lock.unlock();
+    try {
+      load_(request);
+    } catch (const std::exception &) {
+      // The tile will be loaded on demand.
+    }
+    lock.lock();
+    pending_.erase(std::make_tuple(request.dataset, request.node, request.key));
+  }
+}
+
+}  // namespace hydrosheds
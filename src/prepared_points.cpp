@@ -0,0 +1,43 @@
+#include "hydrosheds/prepared_points.hpp"
+
+#include <algorithm>
+#include <tuple>
+#include <utility>
+
+namespace hydrosheds {
+
+PreparedPoints::PreparedPoints(size_t size, size_t tile_size,
+                               std::vector<Grid> grids,
+                               std::vector<Address> addresses)
+    : size_(size), tile_size_(tile_size), grids_(std::move(grids)) {
+  // Sort the tiles of a dataset by row, and the pixels of a tile by offset,
+  // so that the tiles and the pixels are visited in the order of memory.
+  std::sort(addresses.begin(), addresses.end(),
+            [](const Address &lhs, const Address &rhs) {
+              return std::tie(lhs.dataset, std::get<1>(lhs.tile),
+                              std::get<0>(lhs.tile), lhs.offset) <
+                     std::tie(rhs.dataset, std::get<1>(rhs.tile),
+                              std::get<0>(rhs.tile), rhs.offset);
+            });
+
+  points_.resize(addresses.size());
+  offsets_.resize(addresses.size());
+  first_group_.assign(grids_.size() + 1, 0);
+  for (size_t ix = 0; ix < addresses.size(); ++ix) {
+    const auto &item = addresses[ix];
+    points_[ix] = item.point;
+    offsets_[ix] = item.offset;
+    if (ix == 0 || item.dataset != addresses[ix - 1].dataset ||
+        item.tile != addresses[ix - 1].tile) {
+      groups_.push_back({item.tile, ix, ix});
+      ++first_group_[item.dataset + 1];
+    }
+    groups_.back().end = ix + 1;
+  }
+  // Turn the number of groups of each dataset into the index of its first.
+  for (size_t ix = 1; ix < first_group_.size(); ++ix) {
+    first_group_[ix] += first_group_[ix - 1];
+  }
+}
+
+}  // namespace hydrosheds
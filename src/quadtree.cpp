@@ -0,0 +1,179 @@
+#include "hydrosheds/quadtree.hpp"
+
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+
+namespace hydrosheds {
+
+// Signature written at the beginning of the quadtree files.
+constexpr std::array<char, 8> kMagic = {'H', 'S', 'Q', 'T', 'R', 'E', 'E', 1};
+
+// Size of the square blocks read from the raster while building the tree.
+// Must be a power of two so that a block covers a contiguous range of Morton
+// keys.
+constexpr size_t kBlockSize = 4096;
+
+auto LinearQuadtree::build(const std::string &path) -> LinearQuadtree {
+  auto dataset = std::unique_ptr<GDALDataset, void (*)(GDALDataset *)>(
+      reinterpret_cast<GDALDataset *>(GDALOpen(path.c_str(), GA_ReadOnly)),
+      [](GDALDataset *ds) { GDALClose(ds); });
+  if (!dataset) {
+    throw std::runtime_error("Failed to open GeoTIFF file: " + path);
+  }
+
+  auto result = LinearQuadtree();
+  if (dataset->GetGeoTransform(result.geotransform_.data()) != CE_None) {
+    throw std::runtime_error("Failed to get geotransform for file: " + path);
+  }
+  result.projection_ = dataset->GetProjectionRef();
+  result.x_size_ = static_cast<size_t>(dataset->GetRasterXSize());
+  result.y_size_ = static_cast<size_t>(dataset->GetRasterYSize());
+
+  auto *band = dataset->GetRasterBand(1);
+  auto block = std::vector<uint8_t>(kBlockSize * kBlockSize);
+  for (size_t y_offset = 0; y_offset < result.y_size_;
+       y_offset += kBlockSize) {
+    for (size_t x_offset = 0; x_offset < result.x_size_;
+         x_offset += kBlockSize) {
+      auto x_size = std::min(kBlockSize, result.x_size_ - x_offset);
+      auto y_size = std::min(kBlockSize, result.y_size_ - y_offset);
+      // Pixels outside the raster are considered as land.
+      std::fill(block.begin(), block.end(), 0);
+      if (band->RasterIO(GF_Read, static_cast<int>(x_offset),
+                         static_cast<int>(y_offset), static_cast<int>(x_size),
+                         static_cast<int>(y_size), block.data(),
+                         static_cast<int>(x_size), static_cast<int>(y_size),
+                         GDT_Byte, 1, kBlockSize) != CE_None) {
+        throw std::runtime_error("Failed to read block from dataset: " + path);
+      }
+      result.append_block(block, kBlockSize, x_offset, y_offset);
+    }
+  }
+
+  // Blocks are visited row by row, not in Z-order: sort the ranges and merge
+  // those that touch across block boundaries.
+  auto order = std::vector<size_t>(result.begins_.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+    return result.begins_[lhs] < result.begins_[rhs];
+  });
+  auto begins = std::vector<uint64_t>();
+  auto ends = std::vector<uint64_t>();
+  begins.reserve(order.size());
+  ends.reserve(order.size());
+  for (auto ix : order) {
+    if (!ends.empty() && ends.back() == result.begins_[ix]) {
+      ends.back() = result.ends_[ix];
+    } else {
+      begins.push_back(result.begins_[ix]);
+      ends.push_back(result.ends_[ix]);
+    }
+  }
+  result.begins_ = std::move(begins);
+  result.ends_ = std::move(ends);
+  return result;
+}
+
+auto LinearQuadtree::append_block(const std::vector<uint8_t> &block,
+                                  size_t block_size, size_t x_offset,
+                                  size_t y_offset) -> void {
+  auto base = morton_encode(static_cast<uint32_t>(x_offset),
+                            static_cast<uint32_t>(y_offset));
+  auto count = block_size * block_size;
+  auto water = std::count(block.begin(), block.end(), 1);
+
+  // Uniform blocks are a single leaf of the quadtree.
+  if (water == 0) {
+    return;
+  }
+  if (static_cast<size_t>(water) == count) {
+    begins_.push_back(base);
+    ends_.push_back(base + count);
+    return;
+  }
+
+  // Walk the block along the Z-order curve, emitting the runs of water.
+  auto in_run = false;
+  for (uint64_t key = 0; key < count; ++key) {
+    auto x = compact_bits(key);
+    auto y = compact_bits(key >> 1);
+    auto is_water = block[y * block_size + x] == 1;
+    if (is_water && !in_run) {
+      begins_.push_back(base + key);
+    } else if (!is_water && in_run) {
+      ends_.push_back(base + key);
+    }
+    in_run = is_water;
+  }
+  if (in_run) {
+    ends_.push_back(base + count);
+  }
+}
+
+auto LinearQuadtree::load(const std::string &path) -> LinearQuadtree {
+  auto stream = std::ifstream(path, std::ios::binary);
+  if (!stream) {
+    throw std::runtime_error("Failed to open quadtree file: " + path);
+  }
+  auto magic = std::array<char, 8>();
+  uint64_t x_size = 0;
+  uint64_t y_size = 0;
+  uint64_t projection_size = 0;
+  uint64_t size = 0;
+  auto result = LinearQuadtree();
+  stream.read(magic.data(), magic.size());
+  stream.read(reinterpret_cast<char *>(&x_size), sizeof(x_size));
+  stream.read(reinterpret_cast<char *>(&y_size), sizeof(y_size));
+  stream.read(reinterpret_cast<char *>(result.geotransform_.data()),
+              sizeof(double) * result.geotransform_.size());
+  stream.read(reinterpret_cast<char *>(&projection_size),
+              sizeof(projection_size));
+  if (!stream || magic != kMagic) {
+    throw std::runtime_error("Invalid quadtree file: " + path);
+  }
+  result.x_size_ = x_size;
+  result.y_size_ = y_size;
+  result.projection_.resize(projection_size);
+  stream.read(result.projection_.data(),
+              static_cast<std::streamsize>(projection_size));
+  stream.read(reinterpret_cast<char *>(&size), sizeof(size));
+  result.begins_.resize(size);
+  result.ends_.resize(size);
+  stream.read(reinterpret_cast<char *>(result.begins_.data()),
+              static_cast<std::streamsize>(size * sizeof(uint64_t)));
+  stream.read(reinterpret_cast<char *>(result.ends_.data()),
+              static_cast<std::streamsize>(size * sizeof(uint64_t)));
+  if (!stream) {
+    throw std::runtime_error("Truncated quadtree file: " + path);
+  }
+  return result;
+}
+
+auto LinearQuadtree::save(const std::string &path) const -> void {
+  auto stream = std::ofstream(path, std::ios::binary | std::ios::trunc);
+  auto x_size = static_cast<uint64_t>(x_size_);
+  auto y_size = static_cast<uint64_t>(y_size_);
+  auto projection_size = static_cast<uint64_t>(projection_.size());
+  auto size = static_cast<uint64_t>(begins_.size());
+  stream.write(kMagic.data(), kMagic.size());
+  stream.write(reinterpret_cast<const char *>(&x_size), sizeof(x_size));
+  stream.write(reinterpret_cast<const char *>(&y_size), sizeof(y_size));
+  stream.write(reinterpret_cast<const char *>(geotransform_.data()),
+               sizeof(double) * geotransform_.size());
+  stream.write(reinterpret_cast<const char *>(&projection_size),
+               sizeof(projection_size));
+  stream.write(projection_.data(),
+               static_cast<std::streamsize>(projection_size));
+  stream.write(reinterpret_cast<const char *>(&size), sizeof(size));
+  stream.write(reinterpret_cast<const char *>(begins_.data()),
+               static_cast<std::streamsize>(size * sizeof(uint64_t)));
+  stream.write(reinterpret_cast<const char *>(ends_.data()),
+               static_cast<std::streamsize>(size * sizeof(uint64_t)));
+  if (!stream) {
+    throw std::runtime_error("Failed to write quadtree file: " + path);
+  }
+}
+
+}  // namespace hydrosheds
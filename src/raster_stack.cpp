@@ -0,0 +1,277 @@
+#include "hydrosheds/raster_stack.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "hydrosheds/parallel_for.hpp"
+
+namespace hydrosheds {
+
+// Maximum number of tiles of a raster held by the cache of a thread
+constexpr size_t kLocalTiles = 16;
+
+// Get the data type the tiles of a band are stored in: the types read below
+// are kept as is, the others are converted to double.
+inline auto tile_type(GDALDataType type) -> GDALDataType {
+  switch (type) {
+    case GDT_Byte:
+    case GDT_UInt16:
+    case GDT_Int16:
+    case GDT_UInt32:
+    case GDT_Int32:
+    case GDT_Float32:
+    case GDT_Float64:
+      return type;
+    default:
+      return GDT_Float64;
+  }
+}
+
+// Read a pixel of a tile as a double
+inline auto pixel_value(const char *tile, size_t offset, GDALDataType type)
+    -> double {
+  switch (type) {
+    case GDT_Byte:
+      return reinterpret_cast<const uint8_t *>(tile)[offset];
+    case GDT_UInt16:
+      return reinterpret_cast<const uint16_t *>(tile)[offset];
+    case GDT_Int16:
+      return reinterpret_cast<const int16_t *>(tile)[offset];
+    case GDT_UInt32:
+      return reinterpret_cast<const uint32_t *>(tile)[offset];
+    case GDT_Int32:
+      return reinterpret_cast<const int32_t *>(tile)[offset];
+    case GDT_Float32:
+      return reinterpret_cast<const float *>(tile)[offset];
+    default:
+      return reinterpret_cast<const double *>(tile)[offset];
+  }
+}
+
+RasterStack::RasterStack(const std::vector<std::string> &paths,
+                         int espg_code, size_t tile_size,
+                         size_t max_cache_size)
+    : tile_size_(tile_size) {
+  GDALAllRegister();
+
+  // The budget covers all the rasters, each having its own shared cache.
+  auto shared_cache_size =
+      std::max<size_t>(1, max_cache_size / std::max<size_t>(1, paths.size()));
+  local_cache_size_ = std::min(kLocalTiles, shared_cache_size);
+
+  for (const auto &path : paths) {
+    auto dataset = GDALDatasetSmartPtr(
+        reinterpret_cast<GDALDataset *>(GDALOpen(path.c_str(), GA_ReadOnly)),
+        [](GDALDataset *ds) { GDALClose(ds); });
+    if (!dataset) {
+      throw std::runtime_error("Failed to open GeoTIFF file: " + path);
+    }
+    auto geotransform = std::array<double, 6>();
+    if (dataset->GetGeoTransform(geotransform.data()) != CE_None) {
+      throw std::runtime_error("Failed to get geotransform for file: " +
+                               path);
+    }
+    auto x_size = static_cast<size_t>(dataset->GetRasterXSize());
+    auto y_size = static_cast<size_t>(dataset->GetRasterYSize());
+    auto wkt = std::string(dataset->GetProjectionRef());
+    auto *band = dataset->GetRasterBand(1);
+    auto type = tile_type(band->GetRasterDataType());
+    int has_nodata = 0;
+    auto nodata = band->GetNoDataValue(&has_nodata);
+
+    // Group the rasters sharing a coordinate system, then a grid.
+    auto projection = projections_.size();
+    for (size_t ix = 0; ix < projections_.size(); ++ix) {
+      if (same_coordinate_system(projections_[ix].wkt.c_str(), wkt.c_str())) {
+        projection = ix;
+        break;
+      }
+    }
+    if (projection == projections_.size()) {
+      auto transform = create_coordinate_transformation(wkt.c_str(), espg_code);
+      if (!transform) {
+        throw std::runtime_error(
+            "Failed to create coordinate transformation for file: " + path);
+      }
+      projections_.push_back({wkt, std::move(transform), {}});
+    }
+    auto &grids = projections_[projection].grids;
+    auto grid = std::find_if(grids.begin(), grids.end(), [&](size_t ix) {
+      return grids_[ix].geotransform == geotransform &&
+             grids_[ix].x_size == x_size && grids_[ix].y_size == y_size;
+    });
+    auto grid_index = grid == grids.end() ? grids_.size() : *grid;
+    if (grid == grids.end()) {
+      grids_.push_back({geotransform, x_size, y_size,
+                        is_geographic(wkt.c_str()) && is_geographic(espg_code),
+                        {}});
+      grids.push_back(grid_index);
+    }
+    grids_[grid_index].rasters.push_back(rasters_.size());
+
+    rasters_.push_back({std::move(dataset), std::make_unique<std::mutex>(),
+                        type,
+                        static_cast<size_t>(GDALGetDataTypeSizeBytes(type)),
+                        has_nodata != 0, nodata, grid_index,
+                        std::make_unique<SharedTileCache>(shared_cache_size)});
+  }
+}
+
+auto RasterStack::create_context() const -> Context {
+  auto context = Context();
+  for (const auto &item : projections_) {
+    auto transform = OGRCoordinateTransformationSmartPtr(
+        item.transform->Clone(), [](OGRCoordinateTransformation *ct) {
+          OCTDestroyCoordinateTransformation(ct);
+        });
+    if (!transform) {
+      throw std::runtime_error("Failed to clone coordinate transformation.");
+    }
+    context.transforms.push_back(std::move(transform));
+  }
+  for (size_t ix = 0; ix < rasters_.size(); ++ix) {
+    context.caches.emplace_back(local_cache_size_);
+  }
+  return context;
+}
+
+auto RasterStack::read_tile(size_t index, const TileKey &tile_key) const
+    -> Tile {
+  const auto &raster = rasters_[index];
+  const auto &grid = grids_[raster.grid];
+  auto x_offset = static_cast<size_t>(std::get<0>(tile_key)) * tile_size_;
+  auto y_offset = static_cast<size_t>(std::get<1>(tile_key)) * tile_size_;
+  auto width = std::min(tile_size_, grid.x_size - x_offset);
+  auto height = std::min(tile_size_, grid.y_size - y_offset);
+  auto tile_data = std::shared_ptr<char[]>(
+      new char[tile_size_ * tile_size_ * raster.pixel_bytes]);
+  std::lock_guard<std::mutex> lock(*raster.mutex);
+  // The tiles on the right and bottom edges are partial: read them at full
+  // resolution into the top-left corner of the buffer.
+  if (raster.dataset->GetRasterBand(1)->RasterIO(
+          GF_Read, static_cast<int>(x_offset), static_cast<int>(y_offset),
+          static_cast<int>(width), static_cast<int>(height), tile_data.get(),
+          static_cast<int>(width), static_cast<int>(height), raster.type,
+          static_cast<GSpacing>(raster.pixel_bytes),
+          static_cast<GSpacing>(tile_size_ * raster.pixel_bytes)) !=
+      CE_None) {
+    throw std::runtime_error("Failed to read tile from raster.");
+  }
+  return Tile(std::move(tile_data));
+}
+
+auto RasterStack::fetch_tile(size_t index, const TileKey &tile_key,
+                             Context &context) const -> Tile {
+  auto &cache = context.caches[index];
+  auto tile = cache.find_tile(tile_key);
+  if (tile) {
+    return tile;
+  }
+  // Another thread may have read the tile already.
+  auto &shared_cache = *rasters_[index].cache;
+  tile = shared_cache.find_tile(tile_key);
+  if (!tile) {
+    tile = read_tile(index, tile_key);
+    shared_cache.add_tile_to_cache(tile_key, tile);
+  }
+  cache.add_tile_to_cache(tile_key, tile);
+  return tile;
+}
+
+auto RasterStack::sample_chunk(size_t projection, ConstRefVectorFloat64 lon,
+                               ConstRefVectorFloat64 lat, size_t first,
+                               size_t last, Context &context,
+                               std::vector<VectorFloat64> &result) const
+    -> void {
+  auto size = last - first;
+  auto &x = context.x;
+  auto &y = context.y;
+  auto &success = context.success;
+  x.assign(lon.data() + first, lon.data() + last);
+  y.assign(lat.data() + first, lat.data() + last);
+  success.assign(size, 0);
+  // The points that cannot be transformed are flagged instead of aborting
+  // the batch.
+  context.transforms[projection]->Transform(size, x.data(), y.data(), nullptr,
+                                            success.data());
+
+  for (auto index : projections_[projection].grids) {
+    const auto &grid = grids_[index];
+    const auto &geotransform = grid.geotransform;
+    auto x_size = static_cast<double>(grid.x_size);
+    auto y_size = static_cast<double>(grid.y_size);
+    auto &tiles = context.tiles;
+    tiles.assign(grid.rasters.size(), nullptr);
+    auto current = TileKey(-1, -1);
+    for (size_t ix = 0; ix < size; ++ix) {
+      if (!success[ix]) {
+        continue;
+      }
+      auto column = (x[ix] - geotransform[0]) / geotransform[1];
+      if (grid.wrap) {
+        // Wrap the columns to the 360 degrees following the western edge.
+        auto period = 360.0 / geotransform[1];
+        column -= period * std::floor(column / period);
+      }
+      auto row = (y[ix] - geotransform[3]) / geotransform[5];
+      // The points located on the right or bottom edge belong to the last
+      // pixel.
+      if (!(column >= 0 && column <= x_size && row >= 0 && row <= y_size)) {
+        continue;
+      }
+      auto pixel_x = std::min(static_cast<size_t>(column), grid.x_size - 1);
+      auto pixel_y = std::min(static_cast<size_t>(row), grid.y_size - 1);
+      auto tile_key = TileKey(pixel_x / tile_size_, pixel_y / tile_size_);
+      // The rasters of the grid move to the next tile together.
+      if (tile_key != current) {
+        for (size_t jx = 0; jx < grid.rasters.size(); ++jx) {
+          tiles[jx] = fetch_tile(grid.rasters[jx], tile_key, context);
+        }
+        current = tile_key;
+      }
+      auto offset =
+          (pixel_y % tile_size_) * tile_size_ + pixel_x % tile_size_;
+      for (size_t jx = 0; jx < grid.rasters.size(); ++jx) {
+        const auto &raster = rasters_[grid.rasters[jx]];
+        auto value = pixel_value(tiles[jx].get(), offset, raster.type);
+        if (!raster.has_nodata || value != raster.nodata) {
+          result[grid.rasters[jx]](static_cast<Eigen::Index>(first + ix)) =
+              value;
+        }
+      }
+    }
+  }
+}
+
+auto RasterStack::sample(ConstRefVectorFloat64 lon, ConstRefVectorFloat64 lat,
+                         size_t num_threads) const
+    -> std::vector<VectorFloat64> {
+  if (lon.size() != lat.size()) {
+    throw std::invalid_argument("lon and lat must have the same size");
+  }
+  auto result = std::vector<VectorFloat64>();
+  for (size_t ix = 0; ix < rasters_.size(); ++ix) {
+    result.emplace_back(VectorFloat64::Constant(
+        lon.size(), std::numeric_limits<double>::quiet_NaN()));
+  }
+
+  // Each chunk of points is transformed once per coordinate system, then
+  // sampled in all the rasters of the system.
+  auto worker = [&](size_t start, size_t end,
+                    const std::atomic<bool> &cancelled) {
+    auto context = create_context();
+    for (auto first = start; first < end && !cancelled;
+         first += kChunkSize) {
+      auto last = std::min(first + kChunkSize, end);
+      for (size_t ix = 0; ix < projections_.size(); ++ix) {
+        sample_chunk(ix, lon, lat, first, last, context, result);
+      }
+    }
+  };
+  parallel_for(worker, lon.size(), num_threads);
+  return result;
+}
+
+}  // namespace hydrosheds
@@ -0,0 +1,737 @@
+#include "hydrosheds/tiff_reader.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#ifdef HYDROSHEDS_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+#ifdef HYDROSHEDS_IO_URING
+#include <liburing.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define HYDROSHEDS_PREAD
+#endif
+
+namespace hydrosheds {
+
+// TIFF tags used by the reader.
+constexpr uint16_t kImageWidth = 256;
+constexpr uint16_t kImageLength = 257;
+constexpr uint16_t kBitsPerSample = 258;
+constexpr uint16_t kCompression = 259;
+constexpr uint16_t kSamplesPerPixel = 277;
+constexpr uint16_t kPredictor = 317;
+constexpr uint16_t kTileWidth = 322;
+constexpr uint16_t kTileLength = 323;
+constexpr uint16_t kTileOffsets = 324;
+constexpr uint16_t kTileByteCounts = 325;
+constexpr uint16_t kSampleFormat = 339;
+
+// Values of the compression tag decoded by the reader.
+constexpr uint16_t kUncompressed = 1;
+constexpr uint16_t kLzw = 5;
+constexpr uint16_t kDeflate = 8;
+constexpr uint16_t kAdobeDeflate = 32946;
+
+// Special codes and size of the code table of the LZW streams.
+constexpr uint32_t kLzwClear = 256;
+constexpr uint32_t kLzwEnd = 257;
+constexpr uint32_t kLzwFirst = 258;
+constexpr uint32_t kLzwMaxCodes = 4096;
+
+// Number of threads issuing the blocking reads when io_uring is not
+// available.
+constexpr size_t kIoThreads = 8;
+
+// Maximum number of reads in flight in the io_uring queue.
+constexpr unsigned kQueueDepth = 64;
+
+// Number of failed waits on the io_uring queue after which the ring is torn
+// down.
+constexpr size_t kMaxWaitFailures = 3;
+
+// TIFF field types holding integers, with their size in bytes.
+constexpr std::array<std::pair<uint16_t, size_t>, 4> kIntegerTypes = {
+    {{1, 1}, {3, 2}, {4, 4}, {16, 8}}};
+
+#ifdef HYDROSHEDS_PREAD
+
+// Reads exactly size bytes at offset, returns false on a short read.
+inline auto read_at(int fd, uint64_t offset, void *buffer, size_t size)
+    -> bool {
+  auto *cursor = static_cast<char *>(buffer);
+  while (size != 0) {
+    auto count = pread(fd, cursor, size, static_cast<off_t>(offset));
+    if (count <= 0) {
+      return false;
+    }
+    cursor += count;
+    offset += static_cast<uint64_t>(count);
+    size -= static_cast<size_t>(count);
+  }
+  return true;
+}
+
+// Parser of the first image file directory of a TIFF or BigTIFF file.
+class Directory {
+ public:
+  explicit Directory(int fd) : fd_(fd) {}
+
+  // Reads the directory, returns false if the file is not a TIFF file.
+  auto parse() -> bool {
+    auto header = std::array<uint8_t, 16>();
+    if (!read_at(fd_, 0, header.data(), 8)) {
+      return false;
+    }
+    if (header[0] == 'I' && header[1] == 'I') {
+      big_endian_ = false;
+    } else if (header[0] == 'M' && header[1] == 'M') {
+      big_endian_ = true;
+    } else {
+      return false;
+    }
+    auto version = decode(header.data() + 2, 2);
+    uint64_t offset = 0;
+    if (version == 42) {
+      offset = decode(header.data() + 4, 4);
+    } else if (version == 43) {
+      big_tiff_ = true;
+      if (!read_at(fd_, 8, header.data() + 8, 8)) {
+        return false;
+      }
+      offset = decode(header.data() + 8, 8);
+    } else {
+      return false;
+    }
+
+    auto count_size = big_tiff_ ? size_t(8) : size_t(2);
+    auto entry_size = big_tiff_ ? size_t(20) : size_t(12);
+    auto buffer = std::array<uint8_t, 8>();
+    if (!read_at(fd_, offset, buffer.data(), count_size)) {
+      return false;
+    }
+    auto count = decode(buffer.data(), count_size);
+    auto entries = std::vector<uint8_t>(count * entry_size);
+    if (!read_at(fd_, offset + count_size, entries.data(), entries.size())) {
+      return false;
+    }
+    for (size_t ix = 0; ix < count; ++ix) {
+      const auto *entry = entries.data() + ix * entry_size;
+      auto tag = static_cast<uint16_t>(decode(entry, 2));
+      auto type = static_cast<uint16_t>(decode(entry + 2, 2));
+      auto values = decode(entry + 4, big_tiff_ ? 8 : 4);
+      const auto *payload = entry + (big_tiff_ ? 12 : 8);
+      if (!read_values(tag, type, values, payload)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Gets the first value of a tag, or a default value if absent.
+  auto get(uint16_t tag, uint64_t default_value) const -> uint64_t {
+    auto it = tags_.find(tag);
+    return it == tags_.end() || it->second.empty() ? default_value
+                                                   : it->second.front();
+  }
+
+  // Gets the values of a tag.
+  auto values(uint16_t tag) -> std::vector<uint64_t> & { return tags_[tag]; }
+
+ private:
+  int fd_;
+  bool big_endian_{};
+  bool big_tiff_{};
+  std::map<uint16_t, std::vector<uint64_t>> tags_{};
+
+  // Decodes an unsigned integer stored in the byte order of the file.
+  auto decode(const uint8_t *data, size_t size) const -> uint64_t {
+    uint64_t result = 0;
+    for (size_t ix = 0; ix < size; ++ix) {
+      auto shift = 8 * (big_endian_ ? size - 1 - ix : ix);
+      result |= static_cast<uint64_t>(data[ix]) << shift;
+    }
+    return result;
+  }
+
+  // Reads the values of an entry, skipping the tags holding no integers.
+  auto read_values(uint16_t tag, uint16_t type, uint64_t count,
+                   const uint8_t *payload) -> bool {
+    auto it =
+        std::find_if(kIntegerTypes.begin(), kIntegerTypes.end(),
+                     [&](const auto &item) { return item.first == type; });
+    if (it == kIntegerTypes.end()) {
+      return true;
+    }
+    auto size = it->second;
+    auto inline_size = big_tiff_ ? size_t(8) : size_t(4);
+    auto data = std::vector<uint8_t>(count * size);
+    if (data.size() <= inline_size) {
+      std::memcpy(data.data(), payload, data.size());
+    } else if (!read_at(fd_, decode(payload, inline_size), data.data(),
+                        data.size())) {
+      return false;
+    }
+    auto &result = tags_[tag];
+    result.resize(count);
+    for (size_t ix = 0; ix < count; ++ix) {
+      result[ix] = decode(data.data() + ix * size, size);
+    }
+    return true;
+  }
+};
+
+#endif
+
+// Inflates a zlib stream into a buffer of known size.
+inline auto inflate_tile(const std::vector<uint8_t> &source, char *target,
+                         size_t size) -> bool {
+#ifdef HYDROSHEDS_LIBDEFLATE
+  thread_local auto decompressor =
+      std::unique_ptr<libdeflate_decompressor,
+                      void (*)(libdeflate_decompressor *)>(
+          libdeflate_alloc_decompressor(), libdeflate_free_decompressor);
+  size_t written = 0;
+  return decompressor &&
+         libdeflate_zlib_decompress(decompressor.get(), source.data(),
+                                    source.size(), target, size,
+                                    &written) == LIBDEFLATE_SUCCESS &&
+         written == size;
+#else
+  auto written = static_cast<uLongf>(size);
+  return uncompress(reinterpret_cast<Bytef *>(target), &written,
+                    source.data(),
+                    static_cast<uLong>(source.size())) == Z_OK &&
+         written == size;
+#endif
+}
+
+// Decodes a TIFF LZW stream into a buffer of known size. The codes are read
+// most significant bit first, and widened one code before the table fills
+// the current width, as written by libtiff.
+inline auto lzw_decode(const std::vector<uint8_t> &source, char *target,
+                       size_t size) -> bool {
+  // A code past the literals is a run of the bytes already decoded: the
+  // string of the previous code followed by the first byte of the next one.
+  thread_local auto offsets = std::vector<size_t>(kLzwMaxCodes);
+  thread_local auto lengths = std::vector<size_t>(kLzwMaxCodes);
+  auto *output = reinterpret_cast<uint8_t *>(target);
+  size_t position = 0;
+  size_t cursor = 0;
+  uint64_t bits = 0;
+  unsigned available = 0;
+  unsigned width = 9;
+  auto next = kLzwFirst;
+  size_t previous = 0;
+  size_t previous_length = 0;
+  while (position < size) {
+    while (available < width) {
+      if (cursor == source.size()) {
+        return false;
+      }
+      bits = (bits << 8) | source[cursor++];
+      available += 8;
+    }
+    available -= width;
+    auto code = static_cast<uint32_t>(bits >> available) & ((1U << width) - 1);
+    if (code == kLzwClear) {
+      width = 9;
+      next = kLzwFirst;
+      previous_length = 0;
+      continue;
+    }
+    if (code == kLzwEnd) {
+      break;
+    }
+    auto start = position;
+    size_t length = 1;
+    if (code < kLzwClear) {
+      output[position++] = static_cast<uint8_t>(code);
+    } else if (code < next) {
+      length = lengths[code];
+      auto count = std::min(length, size - position);
+      std::memcpy(output + position, output + offsets[code], count);
+      position += count;
+    } else if (code == next && previous_length != 0) {
+      // The code being defined: the previous string followed by its first
+      // byte.
+      length = previous_length + 1;
+      auto count = std::min(previous_length, size - position);
+      std::memcpy(output + position, output + previous, count);
+      position += count;
+      if (position < size) {
+        output[position++] = output[previous];
+      }
+    } else {
+      return false;
+    }
+    if (previous_length != 0 && next < kLzwMaxCodes) {
+      offsets[next] = previous;
+      lengths[next] = previous_length + 1;
+      ++next;
+      if (next + 1 >= (1U << width) && width < 12) {
+        ++width;
+      }
+    }
+    previous = start;
+    previous_length = length;
+  }
+  return position == size;
+}
+
+#ifdef HYDROSHEDS_PREAD
+
+// Threads issuing the blocking reads of the batches when io_uring is not
+// available. The threads are shared by all the readers and started once, so
+// that a few reads are kept in flight without starting threads per batch.
+class ReadPool {
+ public:
+  // Batch submitted to the pool. The reads are claimed in order by the
+  // threads, the calling thread decodes the tiles as they complete.
+  struct Batch {
+    int fd;
+    const std::vector<TiffTileReader::ReadRequest> *requests;
+    // Index of the next read to claim.
+    size_t next{0};
+    // Number of reads not yet completed nor cancelled.
+    size_t remaining;
+    // Index of the completed reads, with their outcome.
+    std::vector<std::pair<size_t, bool>> done{};
+    // Signals a completed read.
+    std::condition_variable ready{};
+  };
+
+  // Gets the pool, starting its threads on first use.
+  static auto instance() -> ReadPool & {
+    static auto pool = ReadPool();
+    return pool;
+  }
+
+  ~ReadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &thread : threads_) {
+      thread.join();
+    }
+  }
+
+  ReadPool(const ReadPool &) = delete;
+  auto operator=(const ReadPool &) -> ReadPool & = delete;
+
+  // Reads a batch, calling complete for each read as it completes. Once a
+  // read or a call to complete has failed, the reads not yet claimed are
+  // cancelled; the function returns after the reads in flight, whose
+  // buffers belong to the caller.
+  template <typename Complete>
+  auto read(int fd, const std::vector<TiffTileReader::ReadRequest> &requests,
+            const Complete &complete) -> void {
+    if (requests.empty()) {
+      return;
+    }
+    auto batch = Batch{fd, &requests, 0, requests.size()};
+    auto exception = std::exception_ptr();
+    auto done = std::vector<std::pair<size_t, bool>>();
+    auto lock = std::unique_lock<std::mutex>(mutex_);
+    batches_.push_back(&batch);
+    wake_.notify_all();
+    while (batch.remaining != 0) {
+      batch.ready.wait(lock, [&] { return !batch.done.empty(); });
+      done.swap(batch.done);
+      lock.unlock();
+      for (const auto &[ix, success] : done) {
+        if (exception) {
+          continue;
+        }
+        try {
+          if (!success) {
+            throw std::runtime_error("Failed to read tile from dataset.");
+          }
+          complete(requests[ix].id);
+        } catch (...) {
+          exception = std::current_exception();
+        }
+      }
+      lock.lock();
+      batch.remaining -= done.size();
+      done.clear();
+      if (exception && batch.next < requests.size()) {
+        batch.remaining -= requests.size() - batch.next;
+        batch.next = requests.size();
+        batches_.erase(std::find(batches_.begin(), batches_.end(), &batch));
+      }
+    }
+    lock.unlock();
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+ private:
+  ReadPool() {
+    for (size_t ix = 0; ix < kIoThreads; ++ix) {
+      threads_.emplace_back([this] { run(); });
+    }
+  }
+
+  // Serves the reads until the pool is destroyed, taking the batches in
+  // turn.
+  auto run() -> void {
+    auto lock = std::unique_lock<std::mutex>(mutex_);
+    while (true) {
+      wake_.wait(lock, [&] { return stop_ || !batches_.empty(); });
+      if (batches_.empty()) {
+        return;
+      }
+      auto *batch = batches_.front();
+      batches_.pop_front();
+      auto ix = batch->next++;
+      if (batch->next < batch->requests->size()) {
+        batches_.push_back(batch);
+      }
+      lock.unlock();
+      const auto &request = (*batch->requests)[ix];
+      auto success =
+          read_at(batch->fd, request.offset, request.target, request.size);
+      lock.lock();
+      batch->done.emplace_back(ix, success);
+      batch->ready.notify_one();
+    }
+  }
+
+  std::mutex mutex_{};
+  // Signals a new batch or the end of the threads.
+  std::condition_variable wake_{};
+  // Batches with reads left to claim.
+  std::deque<Batch *> batches_{};
+  bool stop_{false};
+  std::vector<std::thread> threads_{};
+};
+
+#ifdef HYDROSHEDS_IO_URING
+
+// io_uring queue of a reader.
+struct Ring {
+  io_uring ring{};
+  bool ready;
+
+  Ring() : ready(io_uring_queue_init(kQueueDepth, &ring, 0) == 0) {}
+  ~Ring() { close(); }
+
+  Ring(const Ring &) = delete;
+  auto operator=(const Ring &) -> Ring & = delete;
+
+  // Tears down the ring, cancelling the reads in flight.
+  auto close() -> void {
+    if (ready) {
+      io_uring_queue_exit(&ring);
+      ready = false;
+    }
+  }
+};
+
+#endif
+#endif
+
+struct TiffTileReader::Rings {
+#if defined(HYDROSHEDS_PREAD) && defined(HYDROSHEDS_IO_URING)
+  std::mutex mutex{};
+  std::vector<std::unique_ptr<Ring>> idle{};
+  // False once the kernel has refused to create a queue.
+  bool supported{true};
+
+  // Takes an idle queue, returns null if io_uring is not available.
+  auto acquire() -> std::unique_ptr<Ring> {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!supported) {
+        return nullptr;
+      }
+      if (!idle.empty()) {
+        auto ring = std::move(idle.back());
+        idle.pop_back();
+        return ring;
+      }
+    }
+    auto ring = std::make_unique<Ring>();
+    if (!ring->ready) {
+      std::lock_guard<std::mutex> lock(mutex);
+      supported = false;
+      return nullptr;
+    }
+    return ring;
+  }
+
+  // Gives back a queue, dropping it if it was torn down.
+  auto release(std::unique_ptr<Ring> ring) -> void {
+    if (ring->ready) {
+      std::lock_guard<std::mutex> lock(mutex);
+      idle.push_back(std::move(ring));
+    }
+  }
+#endif
+};
+
+#if defined(HYDROSHEDS_PREAD) && defined(HYDROSHEDS_IO_URING)
+
+// Submits a batch through io_uring, keeping up to kQueueDepth reads in
+// flight.
+template <typename Complete>
+auto read_with_ring(int fd, Ring &ring,
+                    const std::vector<TiffTileReader::ReadRequest> &requests,
+                    const Complete &complete) -> void {
+  size_t submitted = 0;
+  size_t in_flight = 0;
+  size_t failures = 0;
+  auto exception = std::exception_ptr();
+  while (submitted < requests.size() || in_flight != 0) {
+    // Stop submitting after an error, but drain the reads in flight: their
+    // buffers are released when the function returns.
+    while (!exception && submitted < requests.size() &&
+           in_flight < kQueueDepth) {
+      auto *sqe = io_uring_get_sqe(&ring.ring);
+      if (sqe == nullptr) {
+        break;
+      }
+      const auto &request = requests[submitted];
+      io_uring_prep_read(sqe, fd, request.target,
+                         static_cast<unsigned>(request.size), request.offset);
+      io_uring_sqe_set_data64(sqe, submitted);
+      ++submitted;
+      ++in_flight;
+    }
+    if (in_flight == 0) {
+      break;
+    }
+    io_uring_submit(&ring.ring);
+    io_uring_cqe *cqe = nullptr;
+    auto status = io_uring_wait_cqe(&ring.ring, &cqe);
+    if (status == -EINTR) {
+      continue;
+    }
+    if (status != 0) {
+      // Keep waiting for the reads in flight, as after a failed read. If
+      // the ring cannot be waited on, tear it down before returning.
+      if (!exception) {
+        exception = std::make_exception_ptr(
+            std::runtime_error("Failed to wait for the tile reads."));
+      }
+      if (++failures == kMaxWaitFailures) {
+        ring.close();
+        break;
+      }
+      continue;
+    }
+    auto ix = static_cast<size_t>(io_uring_cqe_get_data64(cqe));
+    auto result = cqe->res;
+    io_uring_cqe_seen(&ring.ring, cqe);
+    --in_flight;
+    if (exception) {
+      continue;
+    }
+    try {
+      const auto &request = requests[ix];
+      auto done = result < 0 ? size_t(0) : static_cast<size_t>(result);
+      // Complete a short read synchronously.
+      if (result < 0 ||
+          (done < request.size &&
+           !read_at(fd, request.offset + done,
+                    static_cast<char *>(request.target) + done,
+                    request.size - done))) {
+        throw std::runtime_error("Failed to read tile from dataset.");
+      }
+      complete(request.id);
+    } catch (...) {
+      exception = std::current_exception();
+    }
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+#endif
+
+auto TiffTileReader::open(const std::string &path, size_t tile_size)
+    -> std::unique_ptr<TiffTileReader> {
+#ifdef HYDROSHEDS_PREAD
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  auto result = std::unique_ptr<TiffTileReader>(new TiffTileReader(fd));
+  auto directory = Directory(fd);
+  if (!directory.parse()) {
+    return nullptr;
+  }
+
+  // Only the layouts decoded below are handled, GDAL reads the others.
+  auto compression = directory.get(kCompression, 1);
+  auto predictor = directory.get(kPredictor, 1);
+  if (directory.get(kBitsPerSample, 1) != 8 ||
+      directory.get(kSamplesPerPixel, 1) != 1 ||
+      directory.get(kSampleFormat, 1) != 1 ||
+      directory.get(kTileWidth, 0) != tile_size ||
+      directory.get(kTileLength, 0) != tile_size ||
+      (compression != kUncompressed && compression != kLzw &&
+       compression != kDeflate && compression != kAdobeDeflate) ||
+      (predictor != 1 && predictor != 2)) {
+    return nullptr;
+  }
+  result->x_size_ = directory.get(kImageWidth, 0);
+  result->y_size_ = directory.get(kImageLength, 0);
+  result->tile_size_ = tile_size;
+  result->tiles_x_ = (result->x_size_ + tile_size - 1) / tile_size;
+  result->compression_ = compression == kUncompressed ? Compression::kNone
+                         : compression == kLzw        ? Compression::kLzw
+                                                      : Compression::kDeflate;
+  result->predictor_ = predictor == 2;
+  result->offsets_ = std::move(directory.values(kTileOffsets));
+  result->byte_counts_ = std::move(directory.values(kTileByteCounts));
+
+  auto tiles = result->tiles_x_ * ((result->y_size_ + tile_size - 1) /
+                                   tile_size);
+  if (tiles == 0 || result->offsets_.size() != tiles ||
+      result->byte_counts_.size() != tiles) {
+    return nullptr;
+  }
+  return result;
+#else
+  return nullptr;
+#endif
+}
+
+TiffTileReader::TiffTileReader(int fd)
+    : fd_(fd), rings_(std::make_unique<Rings>()) {}
+
+TiffTileReader::~TiffTileReader() {
+#ifdef HYDROSHEDS_PREAD
+  close(fd_);
+#endif
+}
+
+auto TiffTileReader::tile_index(size_t tile_x, size_t tile_y) const
+    -> size_t {
+  auto index = tile_y * tiles_x_ + tile_x;
+  if (tile_x >= tiles_x_ || index >= offsets_.size()) {
+    throw std::runtime_error("Requested tile is out of bounds.");
+  }
+  if (compression_ == Compression::kNone && byte_counts_[index] != 0 &&
+      byte_counts_[index] < tile_size_ * tile_size_) {
+    throw std::runtime_error("Truncated tile in dataset.");
+  }
+  return index;
+}
+
+auto TiffTileReader::decode(const std::vector<uint8_t> &payload,
+                            char *buffer) const -> void {
+  auto size = tile_size_ * tile_size_;
+  if ((compression_ == Compression::kDeflate &&
+       !inflate_tile(payload, buffer, size)) ||
+      (compression_ == Compression::kLzw &&
+       !lzw_decode(payload, buffer, size))) {
+    throw std::runtime_error("Failed to decode tile from dataset.");
+  }
+
+  // Undo the horizontal differencing.
+  if (predictor_) {
+    for (size_t y = 0; y < tile_size_; ++y) {
+      auto *row = reinterpret_cast<uint8_t *>(buffer) + y * tile_size_;
+      for (size_t x = 1; x < tile_size_; ++x) {
+        row[x] = static_cast<uint8_t>(row[x] + row[x - 1]);
+      }
+    }
+  }
+}
+
+auto TiffTileReader::read(size_t tile_x, size_t tile_y, uint8_t fill,
+                          char *buffer) const -> void {
+  auto index = tile_index(tile_x, tile_y);
+
+  // Sparse files omit the tiles holding only the nodata value.
+  if (byte_counts_[index] == 0) {
+    std::memset(buffer, fill, tile_size_ * tile_size_);
+    return;
+  }
+
+#ifdef HYDROSHEDS_PREAD
+  // The uncompressed tiles are read straight into the buffer.
+  thread_local auto payload = std::vector<uint8_t>();
+  auto compressed = compression_ != Compression::kNone;
+  payload.resize(compressed ? byte_counts_[index] : 0);
+  auto *target = compressed ? static_cast<void *>(payload.data()) : buffer;
+  auto size = compressed ? payload.size() : tile_size_ * tile_size_;
+  if (!read_at(fd_, offsets_[index], target, size)) {
+    throw std::runtime_error("Failed to read tile from dataset.");
+  }
+#endif
+  decode(payload, buffer);
+}
+
+auto TiffTileReader::read_batch(const std::vector<TileRead> &reads,
+                                uint8_t fill) const -> void {
+  auto compressed = compression_ != Compression::kNone;
+  auto payloads = std::vector<std::vector<uint8_t>>(reads.size());
+  auto requests = std::vector<ReadRequest>();
+  requests.reserve(reads.size());
+  for (size_t ix = 0; ix < reads.size(); ++ix) {
+    const auto &item = reads[ix];
+    auto index = tile_index(item.tile_x, item.tile_y);
+    if (byte_counts_[index] == 0) {
+      std::memset(item.buffer, fill, tile_size_ * tile_size_);
+      continue;
+    }
+    auto &payload = payloads[ix];
+    payload.resize(compressed ? byte_counts_[index] : 0);
+    requests.push_back(
+        {ix, offsets_[index],
+         compressed ? static_cast<void *>(payload.data()) : item.buffer,
+         compressed ? payload.size() : tile_size_ * tile_size_});
+  }
+
+  // The tiles are decoded as the reads complete.
+  auto complete = [&](size_t ix) { decode(payloads[ix], reads[ix].buffer); };
+#ifdef HYDROSHEDS_PREAD
+  if (requests.size() == 1) {
+    const auto &request = requests.front();
+    if (!read_at(fd_, request.offset, request.target, request.size)) {
+      throw std::runtime_error("Failed to read tile from dataset.");
+    }
+    complete(request.id);
+    return;
+  }
+#ifdef HYDROSHEDS_IO_URING
+  if (auto ring = rings_->acquire()) {
+    try {
+      read_with_ring(fd_, *ring, requests, complete);
+    } catch (...) {
+      rings_->release(std::move(ring));
+      throw;
+    }
+    rings_->release(std::move(ring));
+    return;
+  }
+#endif
+  ReadPool::instance().read(fd_, requests, complete);
+#endif
+}
+
+}  // namespace hydrosheds
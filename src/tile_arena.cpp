@@ -0,0 +1,102 @@
+#include "hydrosheds/tile_arena.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace hydrosheds {
+
+// Alignment of the slots, to keep the tiles on separate cache lines.
+constexpr size_t kCacheLine = 64;
+
+// Maps a slab of memory aligned on a huge page.
+inline auto map_slab(size_t size) -> char * {
+#ifdef __linux__
+  // Explicit huge pages, only available if the administrator reserved them.
+  auto *slab = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (slab != MAP_FAILED) {
+    return static_cast<char *>(slab);
+  }
+  // Otherwise, map an aligned region and ask for transparent huge pages.
+  auto padded = size + TileArena::kSlabSize;
+  slab = mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (slab == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  auto address = reinterpret_cast<uintptr_t>(slab);
+  auto aligned = (address + TileArena::kSlabSize - 1) &
+                 ~(uintptr_t(TileArena::kSlabSize) - 1);
+  if (aligned != address) {
+    munmap(slab, aligned - address);
+  }
+  auto tail = address + padded - (aligned + size);
+  if (tail != 0) {
+    munmap(reinterpret_cast<void *>(aligned + size), tail);
+  }
+  madvise(reinterpret_cast<void *>(aligned), size, MADV_HUGEPAGE);
+  return reinterpret_cast<char *>(aligned);
+#else
+  auto *slab = std::aligned_alloc(TileArena::kSlabSize, size);
+  if (slab == nullptr) {
+    throw std::bad_alloc();
+  }
+  return static_cast<char *>(slab);
+#endif
+}
+
+// Releases a slab mapped by map_slab.
+inline auto unmap_slab(char *slab, size_t size) -> void {
+#ifdef __linux__
+  munmap(slab, size);
+#else
+  std::free(slab);
+#endif
+}
+
+TileArena::Pool::Pool(size_t slot_size)
+    : slot_size_((slot_size + kCacheLine - 1) / kCacheLine * kCacheLine),
+      slab_size_((slot_size_ + kSlabSize - 1) / kSlabSize * kSlabSize) {}
+
+TileArena::Pool::~Pool() {
+  for (auto *slab : slabs_) {
+    unmap_slab(slab, slab_size_);
+  }
+}
+
+auto TileArena::Pool::acquire() -> char * {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_.empty()) {
+    auto *slab = map_slab(slab_size_);
+    slabs_.push_back(slab);
+    // Hand out the slots in address order.
+    for (auto count = slab_size_ / slot_size_; count-- > 0;) {
+      free_.push_back(slab + count * slot_size_);
+    }
+  }
+  auto *slot = free_.back();
+  free_.pop_back();
+  return slot;
+}
+
+auto TileArena::Pool::release(char *slot) -> void {
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_.push_back(slot);
+}
+
+TileArena::TileArena(size_t slot_size)
+    : slot_size_(slot_size), pool_(std::make_shared<Pool>(slot_size)) {}
+
+auto TileArena::allocate() -> std::shared_ptr<char[]> {
+  // The deleter keeps the pool alive until the last tile is released.
+  return std::shared_ptr<char[]>(
+      pool_->acquire(),
+      [pool = pool_](char *slot) { pool->release(slot); });
+}
+
+}  // namespace hydrosheds
@@ -2,17 +2,25 @@
 
 namespace hydrosheds {
 
-auto TileCache::add_tile_to_cache(const TileKey &key,
-                                  std::vector<char> &&tile_data) -> void {
+auto TileCache::add_tile_to_cache(const TileKey &key, Tile tile_data)
+    -> void {
+  // Replace the tile if it is already cached
+  auto it = tile_map_.find(key);
+  if (it != tile_map_.end()) {
+    it->second.first = std::move(tile_data);
+    access_order_.splice(access_order_.begin(), access_order_,
+                         it->second.second);
+    return;
+  }
   // If the cache is full, remove the least recently used tile
-  if (tile_map_.size() >= max_tiles_) {
+  if (tile_map_.size() >= max_tiles_ && !access_order_.empty()) {
     auto deprecated_key = access_order_.back();
     access_order_.pop_back();
     tile_map_.erase(deprecated_key);
   }
   // Add the new tile to the cache
-  tile_map_[key] = std::move(tile_data);
   access_order_.push_front(key);
+  tile_map_[key] = {std::move(tile_data), access_order_.begin()};
 }
 
 }  // namespace hydrosheds
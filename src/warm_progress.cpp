@@ -0,0 +1,81 @@
+#include "hydrosheds/warm_progress.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace hydrosheds {
+
+auto WarmProgress::total_tiles() const -> uint64_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return total_tiles_;
+}
+
+auto WarmProgress::loaded_tiles() const -> uint64_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return loaded_tiles_;
+}
+
+auto WarmProgress::skipped_tiles() const -> uint64_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return skipped_tiles_;
+}
+
+auto WarmProgress::loaded_bytes() const -> uint64_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return loaded_tiles_ * tile_bytes_;
+}
+
+auto WarmProgress::fraction() const -> double {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (total_tiles_ == 0) {
+    return 1.0;
+  }
+  return static_cast<double>(loaded_tiles_) /
+         static_cast<double>(total_tiles_);
+}
+
+auto WarmProgress::done() const -> bool {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return done_;
+}
+
+auto WarmProgress::cancel() -> void {
+  std::lock_guard<std::mutex> lock(mutex_);
+  cancelled_ = true;
+}
+
+auto WarmProgress::cancelled() const -> bool {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return cancelled_;
+}
+
+auto WarmProgress::wait() const -> void {
+  auto lock = std::unique_lock<std::mutex>(mutex_);
+  finished_.wait(lock, [this] { return done_; });
+  if (!error_.empty()) {
+    throw std::runtime_error(error_);
+  }
+}
+
+auto WarmProgress::advance(uint64_t tiles) -> void {
+  std::lock_guard<std::mutex> lock(mutex_);
+  loaded_tiles_ += tiles;
+}
+
+auto WarmProgress::skip(uint64_t tiles) -> void {
+  std::lock_guard<std::mutex> lock(mutex_);
+  skipped_tiles_ += tiles;
+  total_tiles_ -= std::min(tiles, total_tiles_);
+}
+
+auto WarmProgress::finish(std::string error) -> void {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+    error_ = std::move(error);
+  }
+  finished_.notify_all();
+}
+
+}  // namespace hydrosheds